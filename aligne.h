@@ -0,0 +1,46 @@
+#ifndef ALIGNE_H
+#define ALIGNE_H
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+/* allocateur pour std::vector dont les donnees commencent sur une ligne de cache
+ (64 octets) : les boucles sur les tableaux de particules peuvent etre vectorisees
+ avec des chargements alignes */
+#define ALIGNEMENT 64
+
+template<class T>
+class AllocateurAligne {
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template<class U> struct rebind { typedef AllocateurAligne<U> other; };
+
+	AllocateurAligne() {}
+	template<class U> AllocateurAligne(const AllocateurAligne<U> &) {}
+
+	T* allocate(size_t n){
+		void *p = 0;
+		if(posix_memalign(&p, ALIGNEMENT, n*sizeof(T) > 0 ? n*sizeof(T) : ALIGNEMENT) != 0) throw std::bad_alloc();
+		return (T*) p;
+	}
+
+	void deallocate(T *p, size_t){
+		free(p);
+	}
+
+	template<class U> bool operator== (const AllocateurAligne<U> &) const { return true; }
+	template<class U> bool operator!= (const AllocateurAligne<U> &) const { return false; }
+};
+
+typedef std::vector<float, AllocateurAligne<float> > TableauFloat;
+
+#endif
@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "tissu.h"
+#include "pool.h"
+
+/* Balayage de parametres sans affichage : on lit un fichier de specification ou chaque
+ ligne donne une liste de valeurs pour un parametre, et on lance une simulation pour
+ chaque combinaison (produit cartesien), toutes en parallele sur le pool de threads : un
+ essai par thread, chaque essai seul sur son thread (sans le pool pour ses liens).
+ Pour chaque essai on ecrit une ligne CSV des qu'il est fini : les valeurs choisies,
+ l'erreur des liens au dernier pas (residu_max, residu_rms), l'energie cinetique et
+ potentielle (masse 1 par particule mobile), le plus grand allongement relatif des liens
+ et le temps de calcul (temps processeur du thread de l'essai).
+
+ specification (une cle par ligne, valeurs separees par des espaces, # : commentaire) :
+	taille = 55x50 128x128
+	mode = gauss_seidel jacobi xpbd
+	damping = 0.01 0.02
+	iterations = 5 15
+	sous_pas = 1 4
+	compliance = 0,0,0 1e-4,1e-3,1e-2   (etirement,cisaillement,flexion, en XPBD)
+	vent = 0.5,0,0.2 0,0,0
+	gravite = 0,-0.2,0
+	epinglage = drapeau gauche haut coins
+	images = 600
+ une cle absente garde la valeur par defaut (celle de scene.cc, 600 images).
+
+ usage : balayage --spec fichier [--sortie resultats.csv] [--threads N]
+ */
+
+typedef std::chrono::steady_clock Horloge;
+
+// ========== ESSAI ==========
+struct Essai {
+	int large, hauteur;
+	SimParams params;
+	Vec3 vent, gravite;
+	Epinglage epinglage;
+	int images;
+
+	Essai() : large(55), hauteur(50), vent(0.5,0,0.2), gravite(0,-0.2,0), epinglage(EPINGLAGE_DRAPEAU), images(600) {}
+};
+
+static const char *noms_modes[] = { "gauss_seidel", "jacobi", "xpbd" };
+static const char *noms_epinglages[] = { "drapeau", "gauche", "haut", "coins" };
+
+static bool lireVec3(const std::string &texte, Vec3 &v){
+	return sscanf(texte.c_str(), "%f,%f,%f", &v.f[0], &v.f[1], &v.f[2]) == 3;
+}
+
+static bool lireNom(const std::string &texte, const char **noms, int nb, int &choix){
+	for(int i=0; i<nb; i++){
+		if(texte == noms[i]){
+			choix = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* donne a l'essai la valeur d'un parametre ; false si la cle ou la valeur est invalide */
+static bool appliquer(Essai &essai, const std::string &cle, const std::string &valeur){
+	const char *v = valeur.c_str();
+	char *fin = 0;
+	if(cle == "taille") return sscanf(v, "%dx%d", &essai.large, &essai.hauteur) == 2 && essai.large >= 3 && essai.hauteur >= 3;
+	if(cle == "damping"){
+		essai.params.damping = strtof(v, &fin);
+		return *fin == 0;
+	}
+	if(cle == "iterations"){
+		essai.params.iterations = strtol(v, &fin, 10);
+		return *fin == 0 && essai.params.iterations >= 1;
+	}
+	if(cle == "sous_pas"){
+		essai.params.sous_pas = strtol(v, &fin, 10);
+		return *fin == 0 && essai.params.sous_pas >= 1;
+	}
+	if(cle == "images"){
+		essai.images = strtol(v, &fin, 10);
+		return *fin == 0 && essai.images >= 1;
+	}
+	if(cle == "mode"){
+		int mode;
+		if(!lireNom(valeur, noms_modes, 3, mode)) return false;
+		essai.params.mode = (ModeSolveur) mode;
+		return true;
+	}
+	if(cle == "epinglage"){
+		int epinglage;
+		if(!lireNom(valeur, noms_epinglages, 4, epinglage)) return false;
+		essai.epinglage = (Epinglage) epinglage;
+		return true;
+	}
+	if(cle == "compliance"){
+		SimParams &p = essai.params;
+		return sscanf(v, "%f,%f,%f", &p.compliance_etirement, &p.compliance_cisaillement, &p.compliance_flexion) == 3;
+	}
+	if(cle == "vent") return lireVec3(valeur, essai.vent);
+	if(cle == "gravite") return lireVec3(valeur, essai.gravite);
+	return false;
+}
+
+// ========== SPECIFICATION ==========
+/* un parametre balaye et ses valeurs (telles qu'ecrites dans le fichier) */
+struct Axe {
+	std::string cle;
+	std::vector<std::string> valeurs;
+};
+
+static bool lireSpecification(const char *chemin, std::vector<Axe> &axes){
+	FILE *fichier = fopen(chemin, "r");
+	if(!fichier){
+		fprintf(stderr, "balayage : impossible d'ouvrir %s\n", chemin);
+		return false;
+	}
+	char ligne[4096];
+	int numero = 0;
+	bool ok = true;
+	while(ok && fgets(ligne, sizeof(ligne), fichier)){
+		numero++;
+		char *commentaire = strchr(ligne, '#');
+		if(commentaire) *commentaire = 0;
+		char *egal = strchr(ligne, '=');
+		if(!egal){
+			if(strtok(ligne, " \t\r\n")){
+				fprintf(stderr, "%s:%d : '=' attendu\n", chemin, numero);
+				ok = false;
+			}
+			continue;
+		}
+		*egal = 0;
+		char *cle = strtok(ligne, " \t\r\n");
+		Axe axe;
+		axe.cle = cle ? cle : "";
+		for(char *mot = strtok(egal+1, " \t\r\n"); mot; mot = strtok(0, " \t\r\n")) axe.valeurs.push_back(mot);
+		if(axe.valeurs.empty()){
+			fprintf(stderr, "%s:%d : aucune valeur pour '%s'\n", chemin, numero, axe.cle.c_str());
+			ok = false;
+		}
+		for(size_t i=0; ok && i<axe.valeurs.size(); i++){
+			Essai essai;
+			if(!appliquer(essai, axe.cle, axe.valeurs[i])){
+				fprintf(stderr, "%s:%d : valeur invalide '%s' pour '%s'\n", chemin, numero, axe.valeurs[i].c_str(), axe.cle.c_str());
+				ok = false;
+			}
+		}
+		for(size_t a=0; ok && a<axes.size(); a++){
+			if(axes[a].cle == axe.cle){
+				fprintf(stderr, "%s:%d : '%s' deja donne\n", chemin, numero, axe.cle.c_str());
+				ok = false;
+			}
+		}
+		if(ok) axes.push_back(axe);
+	}
+	fclose(fichier);
+	return ok;
+}
+
+/* l'essai numero n du produit cartesien : le dernier axe varie le plus vite */
+static Essai essaiNumero(const std::vector<Axe> &axes, long n, std::vector<int> &choix){
+	Essai essai;
+	choix.assign(axes.size(), 0);
+	for(int a=(int) axes.size()-1; a>=0; a--){
+		choix[a] = (int)(n % axes[a].valeurs.size());
+		n /= axes[a].valeurs.size();
+	}
+	for(size_t a=0; a<axes.size(); a++) appliquer(essai, axes[a].cle, axes[a].valeurs[choix[a]]);
+	return essai;
+}
+
+// ========== MESURES ==========
+struct Mesures {
+	float residu_max, residu_rms;
+	double cinetique, potentielle;
+	float etirement_max;
+	double secondes;
+};
+
+/* temps processeur du thread appelant, en secondes : ne compte ni les autres essais qui
+ partagent les coeurs ni les attentes */
+static double secondesProcesseur(){
+	struct timespec t;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+	return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+/* meme pas que la scene : gravite et vent multiplies par le pas de temps au carre,
+ sans objets. L'energie potentielle est celle de la gravite (l'acceleration du tissu).
+ Tout l'essai tourne sur le thread appelant (pas de pool) : son temps processeur est
+ exactement le sien. */
+static Mesures simuler(const Essai &essai){
+	double debut = secondesProcesseur();
+	Tissu tissu(15*essai.large/55.0f, 10*essai.hauteur/50.0f, essai.large, essai.hauteur, essai.params, essai.epinglage);
+	Collisionneurs objets;
+	float dt2 = essai.params.time_stepsize2;
+	for(int image=0; image<essai.images; image++) tissu.doFrame(essai.gravite*dt2, essai.vent*dt2, objets);
+
+	Mesures m;
+	m.residu_max = tissu.getResiduMax();
+	m.residu_rms = tissu.getResiduRms();
+	m.cinetique = 0;
+	m.potentielle = 0;
+	for(int i=0; i<tissu.getNbParticules(); i++){
+		if(!tissu.isMovable(i)) continue;
+		Vec3 v = tissu.getVitesse(i);
+		m.cinetique += 0.5*v.dot(v);
+		m.potentielle -= essai.gravite.dot(tissu.getPos(i));
+	}
+	m.etirement_max = tissu.etirementMax();
+	m.secondes = secondesProcesseur()-debut;
+	return m;
+}
+
+// ========== SORTIE ==========
+/* une valeur du fichier de specification dans une case CSV (les vecteurs contiennent des virgules) */
+static void ecrireCase(FILE *sortie, const std::string &valeur){
+	if(valeur.find(',') != std::string::npos) fprintf(sortie, ",\"%s\"", valeur.c_str());
+	else fprintf(sortie, ",%s", valeur.c_str());
+}
+
+int main(int argc, char **argv){
+	const char *spec = 0;
+	const char *chemin_sortie = 0;
+	int nb_threads = 0;
+	for(int i=1; i<argc; i++){
+		if(!strcmp(argv[i],"--spec") && i+1<argc) spec = argv[++i];
+		else if(!strcmp(argv[i],"--sortie") && i+1<argc) chemin_sortie = argv[++i];
+		else if(!strcmp(argv[i],"--threads") && i+1<argc) nb_threads = atoi(argv[++i]);
+		else {
+			spec = 0;
+			break;
+		}
+	}
+	if(!spec){
+		fprintf(stderr, "usage : %s --spec fichier [--sortie resultats.csv] [--threads N]\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<Axe> axes;
+	if(!lireSpecification(spec, axes)) return 1;
+	long nb_essais = 1;
+	for(size_t a=0; a<axes.size(); a++) nb_essais *= (long) axes[a].valeurs.size();
+
+	FILE *sortie = stdout;
+	if(chemin_sortie){
+		sortie = fopen(chemin_sortie, "w");
+		if(!sortie){
+			fprintf(stderr, "balayage : impossible d'ecrire %s\n", chemin_sortie);
+			return 1;
+		}
+	}
+
+	PoolThreads pool(nb_threads);
+	fprintf(stderr, "%ld essais sur %d threads\n", nb_essais, pool.getNbThreads());
+	fprintf(sortie, "essai");
+	for(size_t a=0; a<axes.size(); a++) fprintf(sortie, ",%s", axes[a].cle.c_str());
+	fprintf(sortie, ",residu_max,residu_rms,energie_cinetique,energie_potentielle,energie_totale,etirement_max,secondes\n");
+	fflush(sortie);
+
+	// un essai par tache, fait en entier par le thread qui la prend : partager le pool entre
+	// les liens d'un essai et les autres essais melangerait leurs temps. Les lignes sortent
+	// dans l'ordre ou les essais finissent.
+	std::mutex verrou_sortie;
+	Horloge::time_point debut = Horloge::now();
+	pool.parallelFor((int) nb_essais, 1, [&](int premier, int dernier){
+		for(int n=premier; n<dernier; n++){
+			std::vector<int> choix;
+			Essai essai = essaiNumero(axes, n, choix);
+			Mesures m = simuler(essai);
+			std::lock_guard<std::mutex> garde(verrou_sortie);
+			fprintf(sortie, "%d", n);
+			for(size_t a=0; a<axes.size(); a++) ecrireCase(sortie, axes[a].valeurs[choix[a]]);
+			fprintf(sortie, ",%g,%g,%g,%g,%g,%g,%.4f\n", m.residu_max, m.residu_rms, m.cinetique, m.potentielle,
+				m.cinetique+m.potentielle, m.etirement_max, m.secondes);
+			fflush(sortie);
+		}
+	});
+	fprintf(stderr, "%ld essais en %.2f s\n", nb_essais, std::chrono::duration<double>(Horloge::now()-debut).count());
+	if(sortie != stdout) fclose(sortie);
+	return 0;
+}
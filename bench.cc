@@ -0,0 +1,505 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <errno.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "tissu.h"
+#include "simd.h"
+#include "pool.h"
+#include "monde.h"
+#include "profil.h"
+
+/* Banc d'essai sans affichage : on fait avancer des tissus de differentes tailles
+ exactement comme draw() (gravite, vent, pas de temps, collisions balle et cube, normales)
+ et on mesure le nombre de pas par seconde. Avec --objets N, on ajoute N balles et cubes
+ repartis autour du tissu, resolus par Tissu::collisions (--sans-grille : chaque particule
+ teste tous les objets). --epaisseur e active les auto-collisions (SimParams::epaisseur).
+ Avec --doframe, chaque pas est un seul appel a Tissu::doFrame (balle et cube dans le registre),
+ integration fusionnee sauf avec --sans-fusion.
+ --monde N mesure a la place un Monde de N bannieres de tailles variees et d'un drapeau de
+ 512x512, avances ensemble sur le pool (vol de travail).
+ --xpbd passe au solveur XPBD (--sous-pas N, --compliance : souplesse des trois familles de liens) ;
+ --iterations est alors le nombre de passes par sous-pas.
+ --compteurs lit aussi les compteurs du processeur (Linux, perf_event_open) pendant chaque
+ phase, et dans timeStep (ou doFrame) pendant les passes sur les liens et pendant
+ l'integration : IPC, defauts de cache L1 et du dernier niveau, branches mal predites, par
+ lien et par passe pour timeStep et les liens, par particule sinon. Avec plusieurs threads,
+ l'attente active du pool est comptee aussi.
+
+ usage : bench [--max N] [--min-steps S] [--min-time secondes] [--threads N] [--jacobi] [--iterations N] [--damping d] [--tolerance max] [--tolerance-rms rms] [--xpbd] [--sous-pas N] [--compliance etirement cisaillement flexion] [--objets N] [--sans-grille] [--monde N] [--epaisseur e] [--doframe] [--sans-fusion] [--compteurs] [--csv]
+ */
+
+typedef std::chrono::steady_clock Horloge;
+
+// ========== PHASES MESUREES ==========
+/* LIENS et INTEGRATION sont des parties de timeStep (ou de doFrame), mesurees par un
+ ObservateurPhases : les passes sur les liens sont limitees par la latence, l'integration
+ par le debit memoire, les compteurs doivent les separer */
+enum Phase { FORCE, VENT, PAS_DE_TEMPS, LIENS, INTEGRATION, BALLE, CUBE, OBJETS, AUTO, FRAME, NORMALES, NB_PHASES };
+static const char *noms_phases[NB_PHASES] = { "addForce", "windForce", "timeStep", "liens", "integration", "ballCollision", "cubeCollision", "collisions", "autoCollisions", "doFrame", "calculerNormales" };
+
+static bool estSousPhase(int phase){
+	return phase == LIENS || phase == INTEGRATION;
+}
+
+// ========== COMPTEURS MATERIELS ==========
+enum Compteur { CYCLES, INSTRUCTIONS, DEFAUTS_L1, DEFAUTS_LLC, BRANCHES_RATEES, NB_COMPTEURS };
+static const char *noms_compteurs[NB_COMPTEURS] = { "cycles", "instructions", "l1", "llc", "branches" };
+
+/* Un compteur par evenement, du code utilisateur seulement (autorise jusqu'a
+ perf_event_paranoid = 2), tous dans un meme groupe mene par les cycles : le noyau les
+ programme ensemble, ainsi l'IPC et les defauts par cycle portent sur les memes instants.
+ Ouverts avec inherit avant la creation du pool, ils comptent aussi les threads du pool
+ (attente active comprise) ; la lecture de chaque descripteur fait la somme des threads
+ (PERF_FORMAT_GROUP, qui lirait le groupe d'un coup, n'est pas permis avec inherit sur
+ les noyaux anciens). Quand le groupe ne tient pas toujours dans les registres du
+ processeur, le noyau le fait tourner avec d'autres : une phase est extrapolee avec ses
+ propres temps, voir Lecture. Un evenement qui ne s'ouvre pas (pas de PMU dans une
+ machine virtuelle, droits insuffisants, autre systeme) reste indisponible, les autres
+ sont quand meme lus ; le premier ouvert mene le groupe si les cycles manquent. */
+class CompteursMateriels {
+public:
+	/* valeurs brutes depuis l'ouverture : compte, temps ou l'evenement etait active, temps
+	 ou il comptait vraiment. Une phase se mesure par difference des trois puis
+	 extrapolation (compte*active/compte) : la difference de deux totaux deja extrapoles
+	 melangerait les taux de comptage d'avant et de pendant la phase. */
+	struct Lecture {
+		uint64_t valeur[NB_COMPTEURS], active[NB_COMPTEURS], compte[NB_COMPTEURS];
+	};
+
+	/* compte extrapole du compteur c entre deux lectures, 0 s'il n'a jamais tourne entre elles */
+	static double ecart(const Lecture &depart, const Lecture &fin, int c){
+		uint64_t compte = fin.compte[c]-depart.compte[c];
+		if(compte == 0) return 0;
+		return (double) (fin.valeur[c]-depart.valeur[c])*(fin.active[c]-depart.active[c])/compte;
+	}
+
+private:
+	int fd[NB_COMPTEURS];
+
+public:
+	CompteursMateriels(){
+		for(int c=0; c<NB_COMPTEURS; c++) fd[c] = -1;
+	}
+
+	~CompteursMateriels(){
+#ifdef __linux__
+		for(int c=0; c<NB_COMPTEURS; c++) if(fd[c] >= 0) close(fd[c]);
+#endif
+	}
+
+	/* faux si aucun compteur n'est disponible ; la raison est ecrite sur stderr */
+	bool ouvrir(){
+#ifdef __linux__
+		static const uint64_t cache_defauts_lecture = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		static const struct { uint32_t type; uint64_t config; } evenements[NB_COMPTEURS] = {
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+			{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cache_defauts_lecture },
+			{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cache_defauts_lecture },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+		};
+		int nb_ouverts = 0, meneur = -1;
+		for(int c=0; c<NB_COMPTEURS; c++){
+			struct perf_event_attr attributs;
+			memset(&attributs, 0, sizeof(attributs));
+			attributs.size = sizeof(attributs);
+			attributs.type = evenements[c].type;
+			attributs.config = evenements[c].config;
+			attributs.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			attributs.inherit = 1;
+			attributs.exclude_kernel = 1;
+			attributs.exclude_hv = 1;
+			fd[c] = (int) syscall(__NR_perf_event_open, &attributs, 0, -1, meneur, 0);
+			if(fd[c] < 0 && meneur >= 0){ // groupe trop grand pour le processeur : compte seul
+				fd[c] = (int) syscall(__NR_perf_event_open, &attributs, 0, -1, -1, 0);
+				if(fd[c] >= 0) fprintf(stderr, "compteur %s hors du groupe\n", noms_compteurs[c]);
+			}
+			if(fd[c] >= 0 && meneur < 0) meneur = fd[c];
+			if(fd[c] >= 0) nb_ouverts++;
+			else fprintf(stderr, "compteur %s indisponible : %s\n", noms_compteurs[c], strerror(errno));
+		}
+		return nb_ouverts > 0;
+#else
+		fprintf(stderr, "compteurs materiels : seulement sous Linux\n");
+		return false;
+#endif
+	}
+
+	bool estDisponible(int c) const { return fd[c] >= 0; }
+
+	/* zeros pour un compteur indisponible */
+	void lire(Lecture &lecture) const {
+		for(int c=0; c<NB_COMPTEURS; c++){
+			lecture.valeur[c] = lecture.active[c] = lecture.compte[c] = 0;
+#ifdef __linux__
+			uint64_t lu[3]; // valeur, temps active, temps compte
+			if(fd[c] < 0 || read(fd[c], lu, sizeof(lu)) != (ssize_t) sizeof(lu)) continue;
+			lecture.valeur[c] = lu[0];
+			lecture.active[c] = lu[1];
+			lecture.compte[c] = lu[2];
+#endif
+		}
+	}
+};
+
+struct Taille {
+	int large;
+	int hauteur;
+};
+
+static const Taille tailles[] = { {55,50}, {128,128}, {256,256}, {512,512}, {1024,1024}, {2048,2048} };
+
+struct Resultat {
+	int large, hauteur;
+	int nb_particules, nb_liens;
+	size_t memoire_liens;
+	int pas;
+	long iterations; // somme des passes sur les liens
+	float residu_max, residu_rms; // au dernier pas
+	double secondes[NB_PHASES];
+	double compteurs[NB_PHASES][NB_COMPTEURS];
+	double total;
+};
+
+static double secondesDepuis(Horloge::time_point debut){
+	return std::chrono::duration<double>(Horloge::now()-debut).count();
+}
+
+/* duree (et compteurs, s'il y en a) d'une phase, ajoutee au resultat */
+class ChronoPhase {
+private:
+	const CompteursMateriels *compteurs;
+	Horloge::time_point debut;
+	CompteursMateriels::Lecture depart;
+
+public:
+	explicit ChronoPhase(const CompteursMateriels *compteurs) : compteurs(compteurs) {}
+
+	void demarrer(){
+		if(compteurs) compteurs->lire(depart);
+		debut = Horloge::now();
+	}
+
+	void arreter(Resultat &res, Phase phase){
+		res.secondes[phase] += secondesDepuis(debut);
+		if(!compteurs) return;
+		CompteursMateriels::Lecture fin;
+		compteurs->lire(fin);
+		for(int c=0; c<NB_COMPTEURS; c++) res.compteurs[phase][c] += CompteursMateriels::ecart(depart, fin, c);
+	}
+};
+
+/* passes sur les liens et integration du tissu observe, chacune avec son chronometre */
+class ObservateurBanc : public ObservateurPhases {
+private:
+	Resultat &res;
+	ChronoPhase liens, integration;
+
+public:
+	ObservateurBanc(Resultat &res, const CompteursMateriels *compteurs) : res(res), liens(compteurs), integration(compteurs) {}
+
+	void debut(PhaseProfil phase){
+		if(phase == PROFIL_LIENS) liens.demarrer();
+		else if(phase == PROFIL_INTEGRATION) integration.demarrer();
+	}
+
+	void fin(PhaseProfil phase){
+		if(phase == PROFIL_LIENS) liens.arreter(res, LIENS);
+		else if(phase == PROFIL_INTEGRATION) integration.arreter(res, INTEGRATION);
+	}
+};
+
+/* on garde la meme distance entre particules que la scene de 55x50 (tissu de 15x10),
+ la balle et le cube sont places au meme endroit relativement au tissu */
+/* nb_objets balles et cubes de tailles variees dans le volume ou bouge le tissu
+ (generateur fixe : les memes objets a chaque lancement) */
+static void remplirObjets(Collisionneurs &objets, int nb_objets, float echelle){
+	unsigned int graine = 12345;
+	for(int i=0; i<nb_objets; i++){
+		float hasard[4];
+		for(int k=0; k<4; k++){
+			graine = graine*1103515245u + 12345u;
+			hasard[k] = (graine >> 8)/16777216.0f;
+		}
+		Vec3 centre(hasard[0]*15*echelle, -hasard[1]*15*echelle, (hasard[2]*2-1)*7*echelle);
+		float taille = (0.1f+0.3f*hasard[3])*echelle;
+		if(i%2) objets.ajouterCube(centre, taille);
+		else objets.ajouterSphere(centre, taille);
+	}
+}
+
+static Resultat mesurer(const Taille &taille, int min_pas, double min_temps, PoolThreads *pool, const SimParams &params, int nb_objets, bool grille, bool doframe,
+	const CompteursMateriels *compteurs){
+	float echelle = taille.large/55.0f;
+	Tissu drap(15*echelle, 10*taille.hauteur/50.0f, taille.large, taille.hauteur, params);
+	drap.setPool(pool);
+	Vec3 ball_pos(7*echelle,-5*echelle,0);
+	Vec3 cube_pos(12*echelle,-5*echelle,0);
+	float ball_radius = 2*echelle;
+	float cube_size = 2*echelle;
+	float ball_time = 0;
+	Collisionneurs objets;
+	objets.setGrille(grille);
+	remplirObjets(objets, nb_objets, echelle);
+	int objet_balle = -1;
+	if(doframe){
+		objet_balle = objets.ajouterSphere(ball_pos, ball_radius);
+		objets.ajouterCube(cube_pos, cube_size);
+	}
+
+	Resultat res;
+	memset(&res, 0, sizeof(res));
+	res.large = taille.large;
+	res.hauteur = taille.hauteur;
+	res.nb_particules = drap.getNbParticules();
+	res.nb_liens = drap.getNbLiens();
+	res.memoire_liens = drap.getMemoireLiens();
+
+	ChronoPhase chrono(compteurs);
+	ObservateurBanc observateur(res, compteurs);
+	drap.setObservateur(&observateur);
+	Horloge::time_point debut = Horloge::now();
+	while(res.pas < min_pas || res.total < min_temps){
+		ball_time++;
+		ball_pos.f[2] = cos(ball_time/50.0)*7*echelle;
+
+		if(doframe){
+			chrono.demarrer();
+			objets.get(objet_balle).centre = ball_pos;
+			objets.miseAJour();
+			drap.doFrame(Vec3(0,-0.2,0)*params.time_stepsize2, Vec3(0.5,0,0.2)*params.time_stepsize2, objets);
+			chrono.arreter(res, FRAME);
+			chrono.demarrer();
+			drap.calculerNormales();
+			chrono.arreter(res, NORMALES);
+			res.iterations += drap.getIterations();
+			res.residu_max = drap.getResiduMax();
+			res.residu_rms = drap.getResiduRms();
+			res.pas++;
+			res.total = secondesDepuis(debut);
+			continue;
+		}
+
+		chrono.demarrer();
+		drap.addForce(Vec3(0,-0.2,0)*params.time_stepsize2);
+		chrono.arreter(res, FORCE);
+
+		chrono.demarrer();
+		drap.windForce(Vec3(0.5,0,0.2)*params.time_stepsize2);
+		chrono.arreter(res, VENT);
+
+		chrono.demarrer();
+		drap.timeStep();
+		chrono.arreter(res, PAS_DE_TEMPS);
+		res.iterations += drap.getIterations();
+		res.residu_max = drap.getResiduMax();
+		res.residu_rms = drap.getResiduRms();
+
+		chrono.demarrer();
+		drap.ballCollision(ball_pos,ball_radius);
+		chrono.arreter(res, BALLE);
+
+		chrono.demarrer();
+		drap.cubeCollision(cube_pos, cube_size, cube_pos);
+		chrono.arreter(res, CUBE);
+
+		chrono.demarrer();
+		objets.miseAJour();
+		drap.collisions(objets);
+		chrono.arreter(res, OBJETS);
+
+		chrono.demarrer();
+		drap.autoCollisions();
+		chrono.arreter(res, AUTO);
+
+		chrono.demarrer();
+		drap.calculerNormales();
+		chrono.arreter(res, NORMALES);
+
+		res.pas++;
+		res.total = secondesDepuis(debut);
+	}
+	drap.setObservateur(0);
+	return res;
+}
+
+// ========== MONDE ==========
+/* nb_tissus bannieres de 12x16 a 51x63 particules (generateur fixe) et un drapeau de 512x512 */
+static void mesurerMonde(int nb_tissus, int min_pas, double min_temps, PoolThreads *pool, const SimParams &params, bool csv){
+	Monde monde(pool);
+	unsigned int graine = 7;
+	for(int i=0; i<nb_tissus; i++){
+		graine = graine*1103515245u + 12345u;
+		int large = 12 + (graine >> 8)%40;
+		graine = graine*1103515245u + 12345u;
+		int hauteur = 16 + (graine >> 8)%48;
+		monde.ajouterTissu(large*0.25f, hauteur*0.25f, large, hauteur, Vec3((i%20)*12.0f, 0, (i/20)*12.0f), params);
+	}
+	monde.ajouterTissu(30, 30, 512, 512, Vec3(0, 0, -40), params);
+	monde.getObjets().ajouterSphere(Vec3(5,-5,0), 2);
+
+	int pas = 0;
+	double total = 0;
+	Horloge::time_point debut = Horloge::now();
+	while(pas < min_pas || total < min_temps){
+		monde.pas();
+		pas++;
+		total = secondesDepuis(debut);
+	}
+	if(csv) printf("tissus,particules,pas,ms_par_pas,ns_par_particule\n%d,%d,%d,%.3f,%.2f\n", monde.getNbTissus(), monde.getNbParticules(), pas,
+		total*1e3/pas, total*1e9/((double)pas*monde.getNbParticules()));
+	else printf("monde : %d tissus, %d particules : %.2f ms/pas, %.2f ns/particule\n", monde.getNbTissus(), monde.getNbParticules(),
+		total*1e3/pas, total*1e9/((double)pas*monde.getNbParticules()));
+}
+
+// ========== AFFICHAGE ==========
+/* unite des defauts : un lien pendant une passe pour timeStep et les liens, une particule
+ pendant un pas sinon */
+static bool parLien(int phase){
+	return phase == PAS_DE_TEMPS || phase == LIENS;
+}
+
+static double nbUnites(const Resultat &res, int phase){
+	return parLien(phase) ? (double)res.iterations*res.nb_liens : (double)res.pas*res.nb_particules;
+}
+
+/* IPC puis defauts L1, LLC et branches mal predites par unite ; -1 si indisponible */
+static void ratios(const Resultat &res, int phase, const CompteursMateriels &compteurs, double valeurs[4]){
+	const double *c = res.compteurs[phase];
+	valeurs[0] = compteurs.estDisponible(CYCLES) && compteurs.estDisponible(INSTRUCTIONS) && c[CYCLES] > 0 ? c[INSTRUCTIONS]/c[CYCLES] : -1;
+	static const Compteur defauts[3] = { DEFAUTS_L1, DEFAUTS_LLC, BRANCHES_RATEES };
+	for(int k=0; k<3; k++) valeurs[k+1] = compteurs.estDisponible(defauts[k]) ? c[defauts[k]]/nbUnites(res, phase) : -1;
+}
+
+static void afficher(const Resultat &res, bool csv, const CompteursMateriels *compteurs){
+	double ns_particule = res.total*1e9/((double)res.pas*res.nb_particules);
+	double ns_lien = res.secondes[PAS_DE_TEMPS]*1e9/((double)res.iterations*res.nb_liens);
+	double iterations = (double)res.iterations/res.pas;
+	if(csv){
+		printf("%dx%d,%d,%d,%zu,%d,%.3f,%.3f,%.3f,%.2f,%g,%g", res.large, res.hauteur, res.nb_particules, res.nb_liens,
+			res.memoire_liens, res.pas, res.pas/res.total, ns_particule, ns_lien, iterations, res.residu_max, res.residu_rms);
+		for(int p=0; p<NB_PHASES; p++) printf(",%.4f", res.secondes[p]*1e3/res.pas);
+		for(int p=0; p<NB_PHASES && compteurs; p++){
+			double valeurs[4];
+			ratios(res, p, *compteurs, valeurs);
+			for(int k=0; k<4; k++){
+				if(valeurs[k] < 0 || res.secondes[p] == 0) printf(",");
+				else printf(",%.4g", valeurs[k]);
+			}
+		}
+		printf("\n");
+		return;
+	}
+	printf("%5dx%-5d %9d particules %10d liens : %9.2f pas/s  %8.2f ns/particule  %6.3f ns/lien\n",
+		res.large, res.hauteur, res.nb_particules, res.nb_liens, res.pas/res.total, ns_particule, ns_lien);
+	printf("    liens : %.1f Mo (%.1f octets/lien), %.2f iterations/pas, residu max %g rms %g\n", res.memoire_liens/1048576.0,
+		(double)res.memoire_liens/res.nb_liens, iterations, res.residu_max, res.residu_rms);
+	// colonne des noms de phases, au plus long ; les parties de timeStep (ou doFrame) en retrait
+	int largeur = 0;
+	for(int p=0; p<NB_PHASES; p++) largeur = std::max(largeur, (int) strlen(noms_phases[p]) + (estSousPhase(p) ? 2 : 0));
+	for(int p=0; p<NB_PHASES; p++){
+		int retrait = estSousPhase(p) ? 2 : 0;
+		printf("    %*s%-*s %10.3f ms/pas  %5.1f %%\n", retrait, "", largeur-retrait, noms_phases[p], res.secondes[p]*1e3/res.pas, 100*res.secondes[p]/res.total);
+		if(!compteurs || res.secondes[p] == 0) continue;
+		double valeurs[4];
+		ratios(res, p, *compteurs, valeurs);
+		char texte[4][32];
+		for(int k=0; k<4; k++){
+			if(valeurs[k] < 0) strcpy(texte[k], "-");
+			else snprintf(texte[k], sizeof(texte[k]), k == 0 ? "%.2f" : "%.4f", valeurs[k]);
+		}
+		printf("    %*s ipc %s, par %s : defauts L1 %s, LLC %s, branches ratees %s\n", largeur, "", texte[0],
+			parLien(p) ? "lien et par passe" : "particule", texte[1], texte[2], texte[3]);
+	}
+}
+
+// ========== MAIN ==========
+int main(int argc, char **argv){
+	int max_taille = 2048;
+	int min_pas = 3;
+	double min_temps = 1.0;
+	int nb_threads = 0;
+	SimParams params;
+	bool csv = false;
+	int nb_objets = 0;
+	bool grille = true;
+	bool doframe = false;
+	int nb_tissus = 0;
+	bool avec_compteurs = false;
+
+	for(int i=1; i<argc; i++){
+		if(!strcmp(argv[i],"--max") && i+1<argc) max_taille = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"--min-steps") && i+1<argc) min_pas = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"--min-time") && i+1<argc) min_temps = atof(argv[++i]);
+		else if(!strcmp(argv[i],"--threads") && i+1<argc) nb_threads = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"--jacobi")) params.mode = JACOBI;
+		else if(!strcmp(argv[i],"--iterations") && i+1<argc) params.iterations = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"--damping") && i+1<argc) params.damping = atof(argv[++i]);
+		else if(!strcmp(argv[i],"--tolerance") && i+1<argc) params.tolerance_max = atof(argv[++i]);
+		else if(!strcmp(argv[i],"--tolerance-rms") && i+1<argc) params.tolerance_rms = atof(argv[++i]);
+		else if(!strcmp(argv[i],"--xpbd")) params.mode = XPBD;
+		else if(!strcmp(argv[i],"--sous-pas") && i+1<argc) params.sous_pas = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"--compliance") && i+3<argc){
+			params.compliance_etirement = atof(argv[++i]);
+			params.compliance_cisaillement = atof(argv[++i]);
+			params.compliance_flexion = atof(argv[++i]);
+		}
+		else if(!strcmp(argv[i],"--objets") && i+1<argc) nb_objets = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"--sans-grille")) grille = false;
+		else if(!strcmp(argv[i],"--monde") && i+1<argc) nb_tissus = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"--epaisseur") && i+1<argc) params.epaisseur = atof(argv[++i]);
+		else if(!strcmp(argv[i],"--doframe")) doframe = true;
+		else if(!strcmp(argv[i],"--sans-fusion")) params.fusion = false;
+		else if(!strcmp(argv[i],"--compteurs")) avec_compteurs = true;
+		else if(!strcmp(argv[i],"--csv")) csv = true;
+		else {
+			fprintf(stderr, "usage : %s [--max N] [--min-steps S] [--min-time secondes] [--threads N] [--jacobi] [--iterations N] [--damping d] [--tolerance max] [--tolerance-rms rms] [--xpbd] [--sous-pas N] [--compliance etirement cisaillement flexion] [--objets N] [--sans-grille] [--monde N] [--epaisseur e] [--doframe] [--sans-fusion] [--compteurs] [--csv]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	// avant le pool : les compteurs sont herites par ses threads
+	CompteursMateriels compteurs;
+	bool compteurs_ouverts = avec_compteurs && compteurs.ouvrir();
+	if(avec_compteurs && !compteurs_ouverts) fprintf(stderr, "aucun compteur materiel : mesure du temps seulement\n");
+	PoolThreads pool(nb_threads);
+	static const char *noms_solveurs[] = { "gauss-seidel", "jacobi", "xpbd" };
+	if(!csv) printf("noyaux : %s, threads : %d, solveur : %s, objets : %d%s\n", noyauxSimd().nom, pool.getNbThreads(),
+		noms_solveurs[params.mode], nb_objets, grille ? "" : " (sans grille)");
+	if(!csv && params.mode == XPBD) printf("xpbd : %d sous-pas de %d passes, compliance %g %g %g\n", params.sous_pas, params.iterations,
+		params.compliance_etirement, params.compliance_cisaillement, params.compliance_flexion);
+	// inherit compte aussi l'attente active des threads du pool (sched_yield entre les taches)
+	if(compteurs_ouverts && pool.getNbThreads() > 1){
+		fprintf(csv ? stderr : stdout, "compteurs : %d threads, attente active du pool comprise (instructions et IPC gonflees)\n", pool.getNbThreads());
+	}
+	if(nb_tissus > 0){
+		mesurerMonde(nb_tissus, min_pas, min_temps, &pool, params, csv);
+		return 0;
+	}
+	if(csv){
+		printf("grille,particules,liens,octets_liens,pas,pas_par_s,ns_par_particule,ns_par_lien,iterations,residu_max,residu_rms");
+		for(int p=0; p<NB_PHASES; p++) printf(",ms_%s", noms_phases[p]);
+		for(int p=0; p<NB_PHASES && compteurs_ouverts; p++){
+			printf(",ipc_%s,%s_%s,%s_%s,%s_%s", noms_phases[p], noms_compteurs[DEFAUTS_L1], noms_phases[p],
+				noms_compteurs[DEFAUTS_LLC], noms_phases[p], noms_compteurs[BRANCHES_RATEES], noms_phases[p]);
+		}
+		printf("\n");
+	}
+
+	for(unsigned int i=0; i<sizeof(tailles)/sizeof(tailles[0]); i++){
+		if(tailles[i].large > max_taille || tailles[i].hauteur > max_taille) continue;
+		Resultat res = mesurer(tailles[i], min_pas, min_temps, &pool, params, nb_objets, grille, doframe, compteurs_ouverts ? &compteurs : 0);
+		afficher(res, csv, compteurs_ouverts ? &compteurs : 0);
+		fflush(stdout);
+	}
+	return 0;
+}
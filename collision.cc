@@ -0,0 +1,122 @@
+#include <algorithm>
+#include "collision.h"
+
+// ========== REGISTRE DES COLLISIONNEURS ==========
+
+int Collisionneurs::ajouterSphere(const Vec3 centre, float rayon){
+	Collisionneur objet;
+	objet.type = COLLISION_SPHERE;
+	objet.centre = centre;
+	objet.taille = rayon;
+	objet.actif = true;
+	objets.push_back(objet);
+	return (int) objets.size()-1;
+}
+
+int Collisionneurs::ajouterCube(const Vec3 centre, float taille){
+	Collisionneur objet;
+	objet.type = COLLISION_CUBE;
+	objet.centre = centre;
+	objet.taille = taille;
+	objet.actif = true;
+	objets.push_back(objet);
+	return (int) objets.size()-1;
+}
+
+/* chaque objet actif est inscrit dans toutes les cellules que touche sa boite englobante.
+ La taille des cellules est le diametre median des objets, qu'un objet geant ne deforme pas ;
+ un objet qui couvrirait plus de MAX_CELLULES_OBJET cellules (ou sortirait des indices
+ representables) va dans la liste toujours, testee par toutes les particules. */
+void Collisionneurs::miseAJour(){
+	inscriptions.clear();
+	toujours.clear();
+	diametres.clear();
+	for(int c=0; c<3; c++){ // boite vide
+		boite_min[c] = 1;
+		boite_max[c] = -1;
+	}
+	for(size_t i=0; i<objets.size(); i++){
+		const Collisionneur &objet = objets[i];
+		if(!objet.actif) continue;
+		bool premier = diametres.empty();
+		for(int c=0; c<3; c++){
+			boite_min[c] = premier ? objet.centre.f[c]-objet.taille : std::min(boite_min[c], objet.centre.f[c]-objet.taille);
+			boite_max[c] = premier ? objet.centre.f[c]+objet.taille : std::max(boite_max[c], objet.centre.f[c]+objet.taille);
+		}
+		diametres.push_back(2*objet.taille);
+	}
+	masque_alveoles = 0;
+	if(!diametres.empty() && grille){
+		std::nth_element(diametres.begin(), diametres.begin()+diametres.size()/2, diametres.end());
+		taille_cellule = diametres[diametres.size()/2];
+		if(!(taille_cellule >= 1e-6f)) taille_cellule = 1e-6f; // aussi si NaN
+		inverse_taille_cellule = 1/taille_cellule;
+	}
+
+	// (alveole, objet) pour chaque cellule couverte ; sans grille tout est dans l'alveole 0.
+	// Premier passage : compte des cellules (les objets trop grands vont dans toujours)
+	uint64_t nb_cellules = 0;
+	for(size_t i=0; i<objets.size(); i++){
+		const Collisionneur &objet = objets[i];
+		if(!objet.actif) continue;
+		if(!grille){
+			inscriptions.push_back(i);
+			continue;
+		}
+		uint64_t couvertes = 1;
+		for(int c=0; c<3 && couvertes <= MAX_CELLULES_OBJET; c++){
+			float bas = (objet.centre.f[c]-objet.taille)*inverse_taille_cellule;
+			float haut = (objet.centre.f[c]+objet.taille)*inverse_taille_cellule;
+			if(!(bas > -LIMITE_CELLULE && haut < LIMITE_CELLULE)) couvertes = MAX_CELLULES_OBJET+1; // aussi si NaN
+			else couvertes *= (uint64_t) (cellule(objet.centre.f[c]+objet.taille)-cellule(objet.centre.f[c]-objet.taille)+1);
+		}
+		if(couvertes > MAX_CELLULES_OBJET) toujours.push_back(i);
+		else nb_cellules += couvertes;
+	}
+	if(grille && !diametres.empty()){
+		// au moins 2 alveoles : masque_alveoles nul veut dire sans grille
+		uint32_t nb_alveoles = 2;
+		while(nb_alveoles < MAX_ALVEOLES && nb_alveoles < 2*nb_cellules) nb_alveoles *= 2;
+		masque_alveoles = nb_alveoles-1;
+	}
+
+	// second passage : inscription des objets de la grille
+	for(size_t i=0, t=0; masque_alveoles && i<objets.size(); i++){
+		const Collisionneur &objet = objets[i];
+		if(!objet.actif) continue;
+		if(t < toujours.size() && toujours[t] == i){
+			t++;
+			continue;
+		}
+		int min[3], max[3];
+		for(int c=0; c<3; c++){
+			min[c] = cellule(objet.centre.f[c]-objet.taille);
+			max[c] = cellule(objet.centre.f[c]+objet.taille);
+		}
+		for(int cz=min[2]; cz<=max[2]; cz++)
+			for(int cy=min[1]; cy<=max[1]; cy++)
+				for(int cx=min[0]; cx<=max[0]; cx++)
+					inscriptions.push_back((uint64_t) alveole(cx, cy, cz) << 32 | i);
+	}
+	// deux cellules d'un meme objet peuvent tomber dans la meme alveole : on ne le garde qu'une fois
+	std::sort(inscriptions.begin(), inscriptions.end());
+	inscriptions.erase(std::unique(inscriptions.begin(), inscriptions.end()), inscriptions.end());
+
+	debut_alveoles.assign(masque_alveoles+2, 0);
+	contenus.resize(inscriptions.size());
+	for(size_t k=0; k<inscriptions.size(); k++){
+		debut_alveoles[(inscriptions[k] >> 32)+1]++;
+		contenus[k] = (uint32_t) inscriptions[k];
+	}
+	for(uint32_t h=0; h<=masque_alveoles; h++) debut_alveoles[h+1] += debut_alveoles[h];
+}
+
+void Collisionneurs::candidats(const Vec3 &pos, const uint32_t **debut, const uint32_t **fin) const {
+	if(contenus.empty()){
+		*debut = *fin = 0;
+		return;
+	}
+	uint32_t h = masque_alveoles ? alveole(cellule(pos.f[0]), cellule(pos.f[1]), cellule(pos.f[2])) : 0;
+	*debut = &contenus[0]+debut_alveoles[h];
+	*fin = &contenus[0]+debut_alveoles[h+1];
+}
@@ -0,0 +1,112 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <math.h>
+#include "vec3.h"
+
+/* Objets de la scene avec lesquels le tissu entre en collision (balles, cubes).
+ Les objets sont ranges dans une grille uniforme hachee, reconstruite a chaque image
+ par miseAJour() : une particule ne teste que les objets de sa cellule, plus les rares
+ objets trop grands pour la grille, que toutes les particules testent. */
+
+// ========== COLLISIONNEUR ==========
+enum TypeCollisionneur { COLLISION_SPHERE, COLLISION_CUBE };
+
+struct Collisionneur {
+	TypeCollisionneur type;
+	Vec3 centre;
+	float taille; // rayon de la sphere, demi-cote du cube
+	bool actif; // un objet inactif est ignore (sans changer les indices des autres)
+};
+
+/* correction a appliquer a une particule en pos pour la ramener a la surface de l'objet,
+ retourne false si la particule est dehors (meme calcul que ballCollision et cubeCollision) */
+inline bool corrigerCollision(const Collisionneur &objet, const Vec3 &pos, Vec3 &correction){
+	Vec3 v = pos-objet.centre;
+	float l = objet.type == COLLISION_SPHERE ? v.length() : v.distanceCube();
+	if(l >= objet.taille) return false;
+	correction = v.normalized()*(objet.taille-l);
+	return true;
+}
+
+static const float LIMITE_CELLULE = 1 << 30; // indices de cellule representables dans un int
+
+/* alveole d'une cellule (cx, cy, cz) de grille uniforme, avant masquage par la taille de la table */
+inline uint32_t hacherCellule(int cx, int cy, int cz){
+	return (uint32_t) cx*73856093u ^ (uint32_t) cy*19349663u ^ (uint32_t) cz*83492791u;
+}
+
+// ========== REGISTRE DES COLLISIONNEURS ==========
+class Collisionneurs {
+public:
+	enum {
+		MAX_CELLULES_OBJET = 64, // au-dela, l'objet va dans la liste testee par tous
+		MAX_ALVEOLES = 1 << 20
+	};
+
+private:
+	std::vector<Collisionneur> objets;
+
+	// grille hachee : les objets de l'alveole h sont contenus[debut_alveoles[h] .. debut_alveoles[h+1])
+	float taille_cellule, inverse_taille_cellule;
+	uint32_t masque_alveoles; // nombre d'alveoles - 1 (puissance de 2)
+	std::vector<uint32_t> debut_alveoles;
+	std::vector<uint32_t> contenus;
+	std::vector<uint32_t> toujours; // objets hors grille, testes par toutes les particules (croissants)
+	std::vector<uint64_t> inscriptions; // (alveole << 32 | objet), garde pour ne pas reallouer a chaque image
+	std::vector<float> diametres; // idem, pour la mediane
+	bool grille; // false : chaque particule teste tous les objets (pour comparer)
+	float boite_min[3], boite_max[3]; // boite englobant tous les objets actifs
+
+	int cellule(float x) const {
+		// partie entiere par defaut sans appel a floorf (qui n'est pas une instruction sans SSE4.1) ;
+		// bornee pour que la conversion reste definie, aucun objet de la grille n'atteint la borne
+		float v = std::min(LIMITE_CELLULE, std::max(-LIMITE_CELLULE, x*inverse_taille_cellule));
+		int c = (int) v;
+		return c - (v < c);
+	}
+
+	uint32_t alveole(int cx, int cy, int cz) const {
+		return hacherCellule(cx, cy, cz) & masque_alveoles;
+	}
+
+public:
+	Collisionneurs() : taille_cellule(1), inverse_taille_cellule(1), masque_alveoles(0), grille(true) {
+		for(int c=0; c<3; c++){
+			boite_min[c] = 1;
+			boite_max[c] = -1;
+		}
+	}
+
+	int ajouterSphere(const Vec3 centre, float rayon);
+	int ajouterCube(const Vec3 centre, float taille);
+	void vider() { objets.clear(); }
+
+	int getNbObjets() const { return (int) objets.size(); }
+	Collisionneur &get(int i) { return objets[i]; }
+	const Collisionneur &get(int i) const { return objets[i]; }
+
+	void setGrille(bool grille) { this->grille = grille; }
+
+	/* reconstruit la grille apres avoir deplace, ajoute ou (des)active des objets */
+	void miseAJour();
+
+	/* faux si aucun objet ne peut toucher un point en pos (test rapide, avant candidats) */
+	bool pres(const Vec3 &pos) const {
+		return pos.f[0] >= boite_min[0] && pos.f[0] <= boite_max[0] && pos.f[1] >= boite_min[1] && pos.f[1] <= boite_max[1]
+			&& pos.f[2] >= boite_min[2] && pos.f[2] <= boite_max[2];
+	}
+
+	/* indices des objets de la cellule de pos : [*debut, *fin). Les objets de
+	 toujoursTestes() peuvent aussi toucher pos ; les deux listes sont croissantes et disjointes. */
+	void candidats(const Vec3 &pos, const uint32_t **debut, const uint32_t **fin) const;
+	void toujoursTestes(const uint32_t **debut, const uint32_t **fin) const {
+		*debut = toujours.empty() ? 0 : &toujours[0];
+		*fin = *debut + toujours.size();
+	}
+};
+
+#endif
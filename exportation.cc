@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <algorithm>
+#include <zlib.h>
+#include "exportation.h"
+
+// ========== MISE EN FORME ==========
+
+/* decoupe modele autour de son unique %d ou %0Nd (N de 1 a 32) ; faux s'il n'y en a pas,
+ s'il y en a plusieurs ou s'il y a un autre % */
+static bool decouperModele(const char *modele, std::string &prefixe, int &chiffres, std::string &suffixe){
+	const char *pourcent = strchr(modele, '%');
+	if(!pourcent || strchr(pourcent+1, '%')) return false;
+	const char *c = pourcent+1;
+	chiffres = 0;
+	if(*c == '0'){
+		c++;
+		if(*c < '1' || *c > '9') return false;
+		while(*c >= '0' && *c <= '9' && chiffres <= 32) chiffres = 10*chiffres + (*c++ - '0');
+		if(chiffres > 32) return false;
+	}
+	if(*c != 'd') return false;
+	prefixe.assign(modele, pourcent);
+	suffixe.assign(c+1);
+	return true;
+}
+
+static bool petitBoutiste(){
+	uint16_t u = 1;
+	return *(const uint8_t*) &u == 1;
+}
+
+/* fichier ouvert par ecrire : direct, ou compresse en gzip par zlib (sur le thread d'ecriture) */
+struct Sortie {
+	FILE *fichier;
+	gzFile compresse;
+};
+
+static bool ecrireOctets(Sortie &sortie, const void *donnees, size_t nb_octets){
+	if(nb_octets == 0) return true;
+	if(!sortie.compresse) return fwrite(donnees, nb_octets, 1, sortie.fichier) == 1;
+	// gzwrite prend des longueurs en unsigned int : par morceaux pour les tres grandes grilles
+	const char *octets = (const char*) donnees;
+	while(nb_octets > 0){
+		unsigned int morceau = (unsigned int) std::min(nb_octets, (size_t) 1 << 30);
+		if(gzwrite(sortie.compresse, octets, morceau) != (int) morceau) return false;
+		octets += morceau;
+		nb_octets -= morceau;
+	}
+	return true;
+}
+
+static bool termineParGz(const std::string &chemin){
+	return chemin.size() >= 3 && chemin.compare(chemin.size()-3, 3, ".gz") == 0;
+}
+
+static void ajouterTexte(std::vector<char> &sortie, const char *texte, int longueur){
+	sortie.insert(sortie.end(), texte, texte + longueur);
+}
+
+/* les deux triangles de chaque case, comme RenduTissu::preparer ; refaits seulement
+ si la taille de la grille change */
+std::shared_ptr<const Exportateur::Topologie> Exportateur::topologiePour(int large, int hauteur){
+	std::lock_guard<std::mutex> garde(verrou_topologie);
+	if(this->topologie && this->topologie->large == large && this->topologie->hauteur == hauteur) return this->topologie;
+	std::shared_ptr<Topologie> topologie(new Topologie);
+	topologie->large = large;
+	topologie->hauteur = hauteur;
+	std::vector<char> &faces = topologie->faces;
+	faces.reserve((size_t)(large-1)*(hauteur-1)*(format == FORMAT_PLY ? 2*13 : 2*40));
+	for(int y=0; y<hauteur-1; y++){
+		for(int x=0; x<large-1; x++){
+			int32_t i = y*large + x;
+			int32_t triangles[6] = { i+1, i, i+large, i+large+1, i+1, i+large };
+			for(int t=0; t<2; t++){
+				const int32_t *sommets = triangles + 3*t;
+				if(format == FORMAT_PLY){
+					faces.push_back(3);
+					ajouterTexte(faces, (const char*) sommets, 3*sizeof(int32_t));
+				}
+				else {
+					char ligne[64];
+					int n = snprintf(ligne, sizeof(ligne), "f %d//%d %d//%d %d//%d\n", sommets[0]+1, sommets[0]+1,
+						sommets[1]+1, sommets[1]+1, sommets[2]+1, sommets[2]+1);
+					ajouterTexte(faces, ligne, n);
+				}
+			}
+		}
+	}
+	this->topologie = topologie;
+	return topologie;
+}
+
+/* texte : tampon du thread d'ecriture, garde d'une image a l'autre */
+bool Exportateur::ecrire(const Image &image, std::vector<char> &texte){
+	std::shared_ptr<const Topologie> faces = topologiePour(image.large, image.hauteur);
+	const Topologie &topologie = *faces;
+	size_t nb_sommets = (size_t) topologie.large*topologie.hauteur;
+	size_t nb_faces = 2*(size_t)(topologie.large-1)*(topologie.hauteur-1);
+
+	char chemin[1024];
+	int longueur = snprintf(chemin, sizeof(chemin), "%s%0*ld%s", prefixe.c_str(), chiffres, image.numero, suffixe.c_str());
+	if(longueur < 0 || longueur >= (int) sizeof(chemin)){
+		fprintf(stderr, "%s...%s : chemin trop long\n", prefixe.c_str(), suffixe.c_str());
+		return false;
+	}
+	Sortie sortie = { 0, 0 };
+	if(termineParGz(suffixe)){
+		// niveau 1 : le plus rapide, les ecrivains doivent suivre la simulation
+		errno = 0;
+		sortie.compresse = gzopen(chemin, "wb1");
+		if(sortie.compresse) gzbuffer(sortie.compresse, 1 << 18);
+	}
+	else sortie.fichier = fopen(chemin, "wb");
+	if(!sortie.fichier && !sortie.compresse){
+		if(errno) perror(chemin);
+		else fprintf(stderr, "%s : impossible d'ouvrir le fichier\n", chemin);
+		return false;
+	}
+	char entete[512];
+	bool ok;
+	if(format == FORMAT_PLY){
+		// les sommets sont deja dans l'ordre des proprietes : on les ecrit tels quels
+		int n = snprintf(entete, sizeof(entete), "ply\nformat %s 1.0\ncomment tissu image %ld\nelement vertex %zu\n"
+			"property float x\nproperty float y\nproperty float z\nproperty float nx\nproperty float ny\nproperty float nz\n"
+			"element face %zu\nproperty list uchar int vertex_indices\nend_header\n",
+			petitBoutiste() ? "binary_little_endian" : "binary_big_endian", image.numero, nb_sommets, nb_faces);
+		ok = ecrireOctets(sortie, entete, n) && ecrireOctets(sortie, &image.sommets[0], 6*sizeof(float)*nb_sommets);
+	}
+	else {
+		texte.clear();
+		int n = snprintf(entete, sizeof(entete), "# tissu image %ld : %zu sommets, %zu triangles\n", image.numero, nb_sommets, nb_faces);
+		ajouterTexte(texte, entete, n);
+		for(int normales=0; normales<2; normales++){
+			for(size_t i=0; i<nb_sommets; i++){
+				const float *s = &image.sommets[6*i + 3*normales];
+				char ligne[96];
+				n = snprintf(ligne, sizeof(ligne), normales ? "vn %.7g %.7g %.7g\n" : "v %.7g %.7g %.7g\n", s[0], s[1], s[2]);
+				ajouterTexte(texte, ligne, n);
+			}
+		}
+		ok = ecrireOctets(sortie, &texte[0], texte.size());
+	}
+	if(ok && !topologie.faces.empty()) ok = ecrireOctets(sortie, &topologie.faces[0], topologie.faces.size());
+	if(sortie.compresse ? gzclose(sortie.compresse) != Z_OK : fclose(sortie.fichier) != 0) ok = false;
+	if(!ok) fprintf(stderr, "%s : ecriture incomplete\n", chemin);
+	return ok;
+}
+
+// ========== EXPORTATEUR ==========
+
+Exportateur::Exportateur() : chiffres(0), format(FORMAT_PLY), arret(false), nb_images(0), nb_ecrites(0), nb_perdues(0), nb_erreurs(0) {}
+
+Exportateur::~Exportateur(){
+	fermer();
+}
+
+bool Exportateur::ouvrir(const char *modele, FormatMaillage format, int nb_threads, int nb_en_attente){
+	fermer();
+	if(!decouperModele(modele, prefixe, chiffres, suffixe)){
+		fprintf(stderr, "%s : il faut un seul %%d (ou %%0Nd) pour le numero d'image, et aucun autre %%\n", modele);
+		return false;
+	}
+	this->format = format;
+	topologie.reset();
+	images.assign(std::max(1, nb_en_attente), Image());
+	libres.clear();
+	pleines.clear();
+	for(size_t k=0; k<images.size(); k++) libres.push_back((int) k);
+	nb_images = 0;
+	nb_ecrites = 0;
+	nb_perdues = 0;
+	nb_erreurs = 0;
+	arret = false;
+	for(int t=0; t<std::max(1, nb_threads); t++) threads.push_back(std::thread(&Exportateur::boucle, this));
+	return true;
+}
+
+bool Exportateur::ajouterImage(Tissu &tissu){
+	if(threads.empty()) return false;
+	long numero = nb_images++;
+	int k;
+	{
+		std::lock_guard<std::mutex> garde(verrou);
+		if(libres.empty()){
+			nb_perdues++;
+			return false;
+		}
+		k = libres.front();
+		libres.pop_front();
+	}
+	Image &image = images[k];
+	image.sommets.resize(6*(size_t) tissu.getNbParticules());
+	tissu.copierSommets(&image.sommets[0]);
+	image.large = tissu.getNbParticulesLarge();
+	image.hauteur = tissu.getNbParticulesHauteur();
+	image.numero = numero;
+	{
+		std::lock_guard<std::mutex> garde(verrou);
+		pleines.push_back(k);
+	}
+	changement.notify_one();
+	return true;
+}
+
+void Exportateur::boucle(){
+	std::vector<char> texte;
+	for(;;){
+		int k;
+		{
+			std::unique_lock<std::mutex> verrouille(verrou);
+			while(pleines.empty() && !arret) changement.wait(verrouille);
+			if(pleines.empty()) return;
+			k = pleines.front();
+			pleines.pop_front();
+		}
+		if(ecrire(images[k], texte)) nb_ecrites++;
+		else nb_erreurs++;
+		{
+			std::lock_guard<std::mutex> garde(verrou);
+			libres.push_back(k);
+		}
+	}
+}
+
+bool Exportateur::fermer(){
+	if(threads.empty()) return true;
+	{
+		std::lock_guard<std::mutex> garde(verrou);
+		arret = true;
+	}
+	changement.notify_all();
+	for(size_t t=0; t<threads.size(); t++) threads[t].join();
+	threads.clear();
+	images.clear();
+	topologie.reset();
+	return nb_erreurs.load() == 0;
+}
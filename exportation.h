@@ -0,0 +1,89 @@
+#ifndef EXPORTATION_H
+#define EXPORTATION_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <atomic>
+#include "tissu.h"
+
+/* Export d'une suite de maillages pour d'autres logiciels : un fichier par image, la
+ grille du tissu en triangles (les deux triangles de chaque case, dans l'ordre de
+ RenduTissu et de calculerNormales), positions et normales normalisees.
+ FORMAT_PLY : PLY binaire (sommets x y z nx ny nz en float, faces en listes uchar/int),
+ FORMAT_OBJ : OBJ texte (v, vn puis f a//a b//b c//c).
+ Un modele qui finit par .gz ("drapeau_%05d.ply.gz") donne des fichiers compresses en
+ gzip (zlib, niveau 1), par les threads d'ecriture eux aussi. */
+enum FormatMaillage { FORMAT_PLY, FORMAT_OBJ };
+
+// ========== EXPORTATEUR ==========
+/* ajouterImage ne fait que copier les sommets dans un tampon libre et le mettre dans
+ la file ; des threads d'ecriture mettent chaque image en forme, la compressent s'il le
+ faut et l'ecrivent. Les
+ faces ne dependent que de la taille de la grille : le premier thread d'ecriture qui en a
+ besoin les met en forme, une seule fois, puis elles sont recopiees telles quelles dans
+ chaque fichier. La file est bornee : si toutes les images en attente sont prises,
+ l'image est perdue plutot que de bloquer la simulation (ajouterImage retourne false, getNbPerdues les compte). */
+class Exportateur {
+private:
+	/* faces deja mises en forme pour une taille de grille */
+	struct Topologie {
+		int large, hauteur;
+		std::vector<char> faces;
+	};
+
+	struct Image {
+		std::vector<float> sommets; // 6 floats par particule (Tissu::copierSommets)
+		int large, hauteur;
+		long numero;
+	};
+
+	// chemin des fichiers : prefixe, numero d'image sur au moins 'chiffres' chiffres, suffixe
+	std::string prefixe, suffixe;
+	int chiffres;
+	FormatMaillage format;
+	std::shared_ptr<const Topologie> topologie; // de la derniere taille ecrite
+	std::mutex verrou_topologie;
+
+	std::vector<Image> images;
+	std::deque<int> libres, pleines;
+	std::mutex verrou;
+	std::condition_variable changement;
+	std::vector<std::thread> threads;
+	bool arret;
+
+	long nb_images; // images donnees a ajouterImage (perdues comprises)
+	std::atomic<long> nb_ecrites, nb_perdues, nb_erreurs;
+
+	void boucle();
+	bool ecrire(const Image &image, std::vector<char> &texte);
+	std::shared_ptr<const Topologie> topologiePour(int large, int hauteur);
+
+	Exportateur(const Exportateur&);
+	Exportateur &operator=(const Exportateur&);
+
+public:
+	Exportateur();
+	~Exportateur(); // attend la fin des ecritures
+
+	/* modele : chemin des fichiers avec un seul %d (ou %0Nd) remplace par le numero
+	 d'image, par exemple "drapeau_%05d.ply", et aucun autre % ; nb_threads ecrivains,
+	 au plus nb_en_attente images dans la file */
+	bool ouvrir(const char *modele, FormatMaillage format, int nb_threads = 2, int nb_en_attente = 8);
+
+	/* une image du tissu (apres calculerNormales) ; false si elle est perdue (file pleine) */
+	bool ajouterImage(Tissu &tissu);
+
+	/* attend que toutes les images de la file soient ecrites ; false si une ecriture a echoue */
+	bool fermer();
+
+	bool estOuvert() const { return !threads.empty(); }
+	long getNbEcrites() const { return nb_ecrites.load(); }
+	long getNbPerdues() const { return nb_perdues.load(); }
+};
+
+#endif
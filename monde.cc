@@ -0,0 +1,44 @@
+#include <algorithm>
+#include "monde.h"
+#include "pool.h"
+
+// ========== MONDE ==========
+
+Monde::Monde(PoolThreads *pool) : pool(pool), gravite(0,-0.2,0), vent(0.5,0,0.2) {}
+
+Monde::~Monde(){
+	for(size_t i=0; i<tissus.size(); i++) delete tissus[i];
+}
+
+int Monde::ajouterTissu(float large, float hauteur, int nb_particules_large, int nb_particules_hauteur, const Vec3 position, const SimParams &params){
+	Tissu *tissu = new Tissu(large, hauteur, nb_particules_large, nb_particules_hauteur, params);
+	tissu->translater(position);
+	tissu->setPool(pool);
+	tissus.push_back(tissu);
+
+	// les plus grands d'abord : ils ne finissent pas seuls apres tous les autres
+	ordre.push_back((int) tissus.size()-1);
+	std::stable_sort(ordre.begin(), ordre.end(), [this](int a, int b){
+		return tissus[a]->getNbParticules() > tissus[b]->getNbParticules();
+	});
+	return (int) tissus.size()-1;
+}
+
+int Monde::getNbParticules() const {
+	int nb = 0;
+	for(size_t i=0; i<tissus.size(); i++) nb += tissus[i]->getNbParticules();
+	return nb;
+}
+
+void Monde::pas(){
+	objets.miseAJour();
+	auto avancer = [this](int debut, int fin){
+		for(int k=debut; k<fin; k++){
+			Tissu &tissu = *tissus[ordre[k]];
+			float dt2 = tissu.getParams().time_stepsize2;
+			tissu.doFrame(gravite*dt2, vent*dt2, objets);
+		}
+	};
+	if(pool) pool->parallelFor(getNbTissus(), 1, avancer);
+	else avancer(0, getNbTissus());
+}
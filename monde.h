@@ -0,0 +1,51 @@
+#ifndef MONDE_H
+#define MONDE_H
+
+#include <vector>
+#include "tissu.h"
+#include "collision.h"
+
+class PoolThreads;
+
+// ========== MONDE ==========
+/* Plusieurs tissus de tailles quelconques (bannieres, capes...) et les objets qu'ils
+ partagent, avances ensemble : pas() fait un doFrame de chaque tissu, tous en parallele
+ sur le pool. Un grand tissu decoupe lui-meme ses passes en morceaux sur le meme pool
+ (vol de travail), il n'occupe donc pas un seul thread pendant que les autres attendent ;
+ en attendant ses morceaux, son thread n'avance pas d'autre tissu.
+ Les plus grands tissus sont lances en premier. Le resultat de chaque tissu est le meme
+ qu'en l'avancant seul. */
+class Monde {
+private:
+	std::vector<Tissu*> tissus;
+	std::vector<int> ordre; // indices des tissus, du plus grand au plus petit
+	Collisionneurs objets;
+	PoolThreads *pool;
+	Vec3 gravite, vent; // par unite de pas de temps au carre : multipliees par time_stepsize2 de chaque tissu
+
+	Monde(const Monde&);
+	Monde &operator=(const Monde&);
+
+public:
+	Monde(PoolThreads *pool = 0);
+	~Monde();
+
+	/* tissu cree comme Tissu(large, hauteur, ...) puis deplace en position ; retourne son indice */
+	int ajouterTissu(float large, float hauteur, int nb_particules_large, int nb_particules_hauteur, const Vec3 position, const SimParams &params = SimParams());
+
+	int getNbTissus() const { return (int) tissus.size(); }
+	Tissu &getTissu(int i) { return *tissus[i]; }
+	const Tissu &getTissu(int i) const { return *tissus[i]; }
+	int getNbParticules() const;
+
+	/* objets partages par tous les tissus (la grille est refaite a chaque pas) */
+	Collisionneurs &getObjets() { return objets; }
+
+	void setGravite(const Vec3 g) { gravite = g; }
+	void setVent(const Vec3 v) { vent = v; }
+
+	/* une image pour tous les tissus */
+	void pas();
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef OPENGL_H
+#define OPENGL_H
+
+/* En-tetes OpenGL, GLu et GLut selon le systeme : frameworks sur mac, Mesa (ou le pilote
+ installe) ailleurs. Sous Linux, glext.h declare aussi les fonctions recentes
+ (glBufferStorage, glFenceSync...), exportees par libGL ; rendu.cc verifie a l'execution
+ que le contexte les fournit. */
+#ifdef __APPLE__
+#include <OpenGL/gl.h>	   // Fichier Header pour OpenGL32 Library
+#include <OpenGL/glext.h>
+#include <OpenGL/glu.h>    // Fichier Header pour GLu32 Library
+#include <GLUT/glut.h>	  // Fichier Header pour GLut Library
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <GL/glu.h>
+#include <GL/glut.h>
+#endif
+
+#endif
@@ -1,409 +1,20 @@
-#include <openGL/gl.h>	   // Fichier Header pour OpenGL32 Library
-#include <openGL/glu.h>    // Fichier Header pour GLu32 Library
-#include <glut/glut.h>	  // Fichier Header pour GLut Library 
+#include "opengl.h"
 #include <math.h>
+#include <string.h>
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include "tissu.h"
+#include "rendu.h"
+#include "pool.h"
+#include "simulation.h"
+#include "trajectoire.h"
+#include "exportation.h"
+#include "relecture.h"
+#include "profil.h"
 
 
 
-#define DAMPING 0.01 
-#define TIME_STEPSIZE2 0.5*0.5 
-#define LIENS_ITERATIONS 15
-
-
-
-// ========== DEFINITION DE LA CLASSE VEC3 ==========
-class Vec3 {	
-public:
-	float f[3]; // tableau de taille 3
-
-	Vec3(float x, float y, float z){
-		f[0] =x;
-		f[1] =y;
-		f[2] =z;
-	}
-
-	Vec3() {}
-
-	// calcul de la taille 
-	float length(){
-		return sqrt(f[0]*f[0]+f[1]*f[1]+f[2]*f[2]);
-	}
-
-	// normalisation
-	Vec3 normalized(){
-		float l = length();
-		return Vec3(f[0]/l,f[1]/l,f[2]/l);
-	}
-
-	// surcharge des operateurs
-	void operator+= (const Vec3 &v){
-		f[0]+=v.f[0];
-		f[1]+=v.f[1];
-		f[2]+=v.f[2];
-	}
-
-	Vec3 operator/ (const float &a){
-		return Vec3(f[0]/a,f[1]/a,f[2]/a);
-	}
-
-	Vec3 operator- (const Vec3 &v){
-		return Vec3(f[0]-v.f[0],f[1]-v.f[1],f[2]-v.f[2]);
-	}
-
-	Vec3 operator+ (const Vec3 &v)	{
-		return Vec3(f[0]+v.f[0],f[1]+v.f[1],f[2]+v.f[2]);
-	}
-
-	Vec3 operator* (const float &a){
-		return Vec3(f[0]*a,f[1]*a,f[2]*a);
-	}
-
-	Vec3 operator-(){
-		return Vec3(-f[0],-f[1],-f[2]);
-	}
-
-	Vec3 cross(const Vec3 &v){
-		return Vec3(f[1]*v.f[2] - f[2]*v.f[1], f[2]*v.f[0] - f[0]*v.f[2], f[0]*v.f[1] - f[1]*v.f[0]);
-	}
-
-
-	float dot(const Vec3 &v){
-		return f[0]*v.f[0] + f[1]*v.f[1] + f[2]*v.f[2];
-	}
-	
-	float distanceCube(){
-		// d(A,B) = Max(|xb-xa| + |yb-ya| + |zb-za|)
-		float tmpx = fabs(f[0]);
-		float tmpy = fabs(f[1]);
-		float tmpz = fabs(f[2]);
-		float tmp =  std::max(tmpx,tmpy);
-		return std::max(tmp, tmpz);
-	}
-
-
-
-};
-
-// ========== PARTICULES ==========
-class Particule {
-private:
-	bool movable; // pour savoir si la particule bouge ou non
-	float mass; // poids de la particule
-	Vec3 pos; // position de la particule 
-	Vec3 old_pos; // position de la particule au temps t-1
-	Vec3 acceleration; // acceleration de la particule
-	Vec3 accumulated_normal; 
-
-public:
-	Particule(Vec3 pos) : pos(pos), old_pos(pos),acceleration(Vec3(0,0,0)), mass(1), movable(true), accumulated_normal(Vec3(0,0,0)){}
-	Particule(){}
-
-	void addForce(Vec3 f){
-		acceleration += f/mass;
-	}
-
-	/* 
-	 donne l'equation force = masse*acceleration : la prochaine position est trouvee par l'integrataion de verlet
-	 TIME_STEPSIZE2 = 0.5*0.5
-	 DAMPING = 0.01
-	 */
-	void timeStep() {
-		if(movable)
-		{
-			Vec3 temp = pos;
-			pos = pos + (pos-old_pos)*(1.0-DAMPING) + acceleration*TIME_STEPSIZE2;
-			old_pos = temp;
-			acceleration = Vec3(0,0,0); 
-		}
-	}
-
-	Vec3& getPos() {
-		return pos;
-	}
-
-	void resetAcceleration() {
-		acceleration = Vec3(0,0,0);
-	}
-
-	void offsetPos(const Vec3 v) { 
-		if(movable) pos += v;
-	}
-
-	void makeUnmovable() {
-		movable = false;
-	}
-	
-	void makeMovable() {
-		movable = true;
-	}
-
-	void addToNormal(Vec3 normal){
-		accumulated_normal += normal.normalized();
-	}
-
-	Vec3& getNormal() { 
-		return accumulated_normal;
-	}
-
-	void resetNormal() {
-		accumulated_normal = Vec3(0,0,0);
-	}
-
-};
-
-// ========== CLASSE LIEN ===========
-class Lien {
-private:
-	float rest_distance; // distance entre deux particules
-
-public:
-	Particule *p1, *p2; // deux particules reliees par une meme contrainte
-
-	Lien(Particule *p1, Particule *p2) :  p1(p1),p2(p2){
-		Vec3 vec = p1->getPos()-p2->getPos();
-		rest_distance = vec.length();
-	}
-
-	/* lien entre deux particules	*/
-	void lienPossible() {
-		Vec3 p1_to_p2 = p2->getPos()-p1->getPos(); // vecteur de p1 a p2
-		float current_distance = p1_to_p2.length(); //  distance entre p1  p2
-		Vec3 correctionVector = p1_to_p2*(1 - rest_distance/current_distance); // vecteur de compensation : deplace p1 d'une distance rest_distance de p2
-		Vec3 correctionVectorHalf = correctionVector*0.5; // on prend la moitie de la longueur precedente pour bouger P1 et P2
-		p1->offsetPos(correctionVectorHalf); // correctionVectorHalf pointe de p1 a P2 pour que la longueur puisse bouger P2 de moitie pour satisfaire la creation des liens.
-		p2->offsetPos(-correctionVectorHalf); // on deplace p2 de -direction si on va de P2 a p1 au lieu de P1 a P2	
-	}
-
-};
-
-// ========== DEFINITION DE LA CLASSE TISSU==========
-class Tissu {
-private:
-	std::vector<Particule> particules; // toutes les particules du tissu
-	std::vector<Lien> liens; // tous les liens reliant les particules du tissu entre elles
-	
-	
-	int nb_particules_large; // nombre de particules dans la largeur
-	int nb_particules_hauteur; // nombre de particules dans la hauteur
-	// nb total de particules =  nb_particules_large*nb_particules_hauteur
-	
-	Particule* getParticule(int x, int y) {
-		return &particules[y*nb_particules_large + x];
-	}
-	
-	void creerLien(Particule *p1, Particule *p2) {
-		liens.push_back(Lien(p1,p2));
-	}
-
-
-	
-	Vec3 calcTriangleNormal(Particule *p1,Particule *p2,Particule *p3) {
-		Vec3 pos1 = p1->getPos();
-		Vec3 pos2 = p2->getPos();
-		Vec3 pos3 = p3->getPos();
-
-		Vec3 v1 = pos2-pos1;
-		Vec3 v2 = pos3-pos1;
-
-		return v1.cross(v2);
-	}
-
-	/* Calcul la force du vent pour un triangle de particules p1, p2, p3 */
-	void addWindForcesForTriangle(Particule *p1,Particule *p2,Particule *p3, const Vec3 direction) {
-		Vec3 normal = calcTriangleNormal(p1,p2,p3);
-		Vec3 d = normal.normalized();
-		Vec3 force = normal*(d.dot(direction));
-		p1->addForce(force);
-		p2->addForce(force);
-		p3->addForce(force);
-	}
-
-	/* Dessiner un triangle entre p1,p2,p3 avec une couleur*/
-	void drawTriangle(Particule *p1, Particule *p2, Particule *p3, const Vec3 color){
-		glColor3fv( (float*) &color );
-
-		glNormal3fv((float *) &(p1->getNormal().normalized() ));
-		glVertex3fv((float *) &(p1->getPos()));
-
-		glNormal3fv((float *) &(p2->getNormal().normalized() ));
-		glVertex3fv((float *) &(p2->getPos()));
-
-		glNormal3fv((float *) &(p3->getNormal().normalized() ));
-		glVertex3fv((float *) &(p3->getPos()));
-	}
-
-public:
-	
-	
-
-
-	/* Constructeur pour le tissu (particules + liens)*/
-	Tissu(float large, float hauteur, int nb_particules_large, int nb_particules_hauteur) : nb_particules_large(nb_particules_large), nb_particules_hauteur(nb_particules_hauteur){
-		particules.resize(nb_particules_large*nb_particules_hauteur); //I am essentially using this vector as an array with room for num_particles_width*num_particles_height particles
-
-		// creation des particules dans une grille de (0,0,0) jusqu'a (largeur, hauteur, 0)
-		for(int x=0; x<nb_particules_large; x++){
-			for(int y=0; y<nb_particules_hauteur; y++){
-				Vec3 pos = Vec3(large * (x/(float)nb_particules_large),hauteur * (y/(float)nb_particules_hauteur),0);
-				particules[y*nb_particules_large+x]= Particule(pos);  // colonne x ligne y
-			}
-		}
-
-		// Connexion des particules voisines avec un lien (distance 1 et racine de 2 dans la grille)
-		for(int x=0; x<nb_particules_large; x++){
-			for(int y=0; y<nb_particules_hauteur; y++){
-				if (x<nb_particules_large-1) creerLien(getParticule(x,y),getParticule(x+1,y));
-				if (y<nb_particules_hauteur-1) creerLien(getParticule(x,y),getParticule(x,y+1));
-				if (x<nb_particules_large-1 && y<nb_particules_hauteur-1) creerLien(getParticule(x,y),getParticule(x+1,y+1));
-				if (x<nb_particules_large-1 && y<nb_particules_hauteur-1) creerLien(getParticule(x+1,y),getParticule(x,y+1));
-			}
-		}
-
-
-		// connexion des particules presque voisines avec un lien(distance 2 et racine de 4 dans la grille
-		for(int x=0; x<nb_particules_large; x++){
-			for(int y=0; y<nb_particules_hauteur; y++){
-				if (x<nb_particules_large-2) creerLien(getParticule(x,y),getParticule(x+2,y));
-				if (y<nb_particules_hauteur-2) creerLien(getParticule(x,y),getParticule(x,y+2));
-				if (x<nb_particules_large-2 && y<nb_particules_hauteur-2) creerLien(getParticule(x,y),getParticule(x+2,y+2));
-				if (x<nb_particules_large-2 && y<nb_particules_hauteur-2) creerLien(getParticule(x+2,y),getParticule(x,y+2));			}
-		}
-
-
-		// le haut gauche et droit sur 3 unites seront immobiles
-		for(int i=nb_particules_large/2.5;i<nb_particules_large; i++){
-			getParticule(0+i ,0)->offsetPos(Vec3(0.5,0.0,0.0)); // permet de rendre un effet un peu plus naturel
-			getParticule(0+i ,0)->makeUnmovable(); 
-
-			//getParticule(0+i ,0)->offsetPos(Vec3(-0.5,0.0,0.0)); 
-			//getParticule(nb_particules_large-1-i ,0)->makeUnmovable();
-		}
-		
-		
-		
-		
-	}
-
-	/* 	Le tissu est donc un ensemble de trinagles. pour 4 particules, on a ainsi :
-	 
-	 (x,y)   *--* (x+1,y)
-	 | /|
-	 |/ |
-	 (x,y+1) *--* (x+1,y+1)
-	 
-	 */
-	
-	
-	void drawShaded(){
-		// reinitialiser les normales, qui changent constamment.
-		std::vector<Particule>::iterator particule;
-		for(particule = particules.begin(); particule != particules.end(); particule++){
-			(*particule).resetNormal();
-		}
-
-		//ajout des normales
-		for(int x = 0; x<nb_particules_large-1; x++){
-			for(int y=0; y<nb_particules_hauteur-1; y++){
-				Vec3 normal = calcTriangleNormal(getParticule(x+1,y),getParticule(x,y),getParticule(x,y+1));
-				getParticule(x+1,y)->addToNormal(normal);
-				getParticule(x,y)->addToNormal(normal);
-				getParticule(x,y+1)->addToNormal(normal);
-
-				normal = calcTriangleNormal(getParticule(x+1,y+1),getParticule(x+1,y),getParticule(x,y+1));
-				getParticule(x+1,y+1)->addToNormal(normal);
-				getParticule(x+1,y)->addToNormal(normal);
-				getParticule(x,y+1)->addToNormal(normal);
-			}
-		}
-
-		// dessin des triangles avec la couleur
-		glBegin(GL_TRIANGLES);
-		for(int x = 0; x<nb_particules_large-1; x++){
-			for(int y=0; y<nb_particules_hauteur-1; y++){
-				Vec3 color(0,0,0);
-				
-				color = Vec3(0.69f,0.13f,0.13f);
-				
-				drawTriangle(getParticule(x+1,y),getParticule(x,y),getParticule(x,y+1),color);
-				drawTriangle(getParticule(x+1,y+1),getParticule(x+1,y),getParticule(x,y+1),color);
-			}
-		}
-		glEnd();
-	}
-
-	/*  on regarde comment vont reagir les liens et les particules au temps t+1*/
-	void timeStep(){
-		std::vector<Lien>::iterator lien;
-		for(int i=0; i<LIENS_ITERATIONS; i++) {// iterations sur tous les liens
-			for(lien = liens.begin(); lien != liens.end(); lien++ ){
-				(*lien).lienPossible();
-			}
-		}
-
-		std::vector<Particule>::iterator particule;
-		for(particule = particules.begin(); particule != particules.end(); particule++){
-			(*particule).timeStep(); // calcul de la position  de chaque particule au temps t+1
-		}
-	}
-
-	/* ajout de la gravite a toutes les particules*/
-	void addForce(const Vec3 direction){
-		std::vector<Particule>::iterator particule;
-		for(particule = particules.begin(); particule != particules.end(); particule++){
-			(*particule).addForce(direction); // add the forces to each particle
-		}
-
-	}
-
-	/* ajout des forces de vent a toutes les particules*/
-	void windForce(const Vec3 direction){
-		for(int x = 0; x<nb_particules_large-1; x++){
-			for(int y=0; y<nb_particules_hauteur-1; y++){
-				addWindForcesForTriangle(getParticule(x+1,y),getParticule(x,y),getParticule(x,y+1),direction);
-				addWindForcesForTriangle(getParticule(x+1,y+1),getParticule(x+1,y),getParticule(x,y+1),direction);
-			}
-		}
-	}
-
-	/* dectection et resolution de la collision tissu/ball
-	 On compare la position de la sphere et de chaque particule et on les corrige
-	 */
-	void ballCollision(const Vec3 center,const float radius ){
-		std::vector<Particule>::iterator particule;
-		for(particule = particules.begin(); particule != particules.end(); particule++){
-			Vec3 v = (*particule).getPos()-center;
-			float l = v.length();
-			if ( l < radius){ // particule a l'interieur de la balle
-				(*particule).offsetPos(v.normalized()*(radius-l)); // on met la particule a la surface de la balle
-			}
-		}
-	}
-	
-	
-	/*detection et resolution d'une collision tissu/cube.*/
-	void cubeCollision(const Vec3 center,const float cube_size,const Vec3 cube_pos){
-		std::vector<Particule>::iterator particule;
-		for(particule = particules.begin(); particule != particules.end(); particule++){
-			Vec3 v = (*particule).getPos()-cube_pos;
-			float l = v.distanceCube();
-			//std::cout << "distance cube : " << l << std::endl;
-			if( l < (cube_size) ){
-				(*particule).offsetPos(v.normalized()*(cube_size-l));
-			}
-		}
-	}
-	
-	
-	
-
-	void doFrame(){
-
-	}
-};
-
 // ========== DESSINER UN REPERE ==========
 void drawRepere(){
 	glBegin(GL_LINES);
@@ -427,98 +38,56 @@ void drawRepere(){
 }
 
 /* ---------------- sphere -----------------------*/
-static void sphere(){
+/* ajoute au maillage une sphere de rayon 1 centree en centre, decoupee comme avant
+ (bandes de 0.5 radian en longitude et en latitude, chaque case en deux triangles) */
+static void sphere(MaillageFixe &maillage, const Vec3 &centre){
 	double surf =0.5;
-	double phi, theta;
-	for(phi = 0 ; phi <= 2*M_PI ; phi += surf){
-		for(theta = -M_PI/2 ; theta <= M_PI/2; theta += surf){
-			glBegin(GL_QUADS);
-			glNormal3f(cos(theta)*cos(phi), cos(theta)*sin(phi), sin(theta));
-			glVertex3d(cos(theta)*cos(phi), cos(theta)*sin(phi), sin(theta));
-			glNormal3f(cos(theta)*cos(phi+surf), cos(theta)*sin(phi+surf), sin(theta));
-			glVertex3d(cos(theta)*cos(phi+surf), cos(theta)*sin(phi+surf), sin(theta));
-			glNormal3f(cos(theta+surf)*cos(phi+surf), cos(theta+surf)*sin(phi+surf), sin(theta+surf));
-			glVertex3d(cos(theta+surf)*cos(phi+surf), cos(theta+surf)*sin(phi+surf), sin(theta+surf));
-			glNormal3f(cos(theta+surf)*cos(phi), cos(theta+surf)*sin(phi), sin(theta+surf));
-			glVertex3d(cos(theta+surf)*cos(phi), cos(theta+surf)*sin(phi), sin(theta+surf));
-			glEnd();
+	std::vector<double> phis, thetas;
+	for(double phi = 0 ; phi <= 2*M_PI ; phi += surf) phis.push_back(phi);
+	for(double theta = -M_PI/2 ; theta <= M_PI/2; theta += surf) thetas.push_back(theta);
+	phis.push_back(phis.back()+surf); // bord des dernieres cases
+	thetas.push_back(thetas.back()+surf);
+
+	int premier = -1;
+	for(size_t i=0; i<phis.size(); i++){
+		for(size_t j=0; j<thetas.size(); j++){
+			Vec3 normal(cos(thetas[j])*cos(phis[i]), cos(thetas[j])*sin(phis[i]), sin(thetas[j]));
+			int s = maillage.ajouterSommet(normal+centre, normal);
+			if(premier < 0) premier = s;
+		}
+	}
+	int nb_thetas = thetas.size();
+	for(int i=0; i<(int)phis.size()-1; i++){
+		for(int j=0; j<nb_thetas-1; j++){
+			int a = premier + i*nb_thetas + j; // (phi, theta)
+			int b = a + nb_thetas; // (phi+surf, theta)
+			maillage.ajouterTriangle(a, b, b+1);
+			maillage.ajouterTriangle(a, b+1, a+1);
+		}
+	}
+}
+
+/* les 70 bosses du sol, dans le repere du plan (avant glScalef) : 10 rangees de 7 */
+static void construirePlan(MaillageFixe &maillage){
+	for(int rangee = -5; rangee < 5; rangee++){
+		for(int k = 1; k <= 7; k++){
+			sphere(maillage, Vec3(1.5f*k, 1.2f*rangee, 0.0f));
 		}
 	}
 }
+
+MaillageFixe sol; // bosses du sol, construites une fois
 // ========== DESSINER LE PLAN ==========
 void drawPlan(){
 	
 	glRotatef(90,1.0,0.0,0.0);
-	/*for (int i = 4; i < 30; i++){
-		for(int j = -10; j < 10; j++){
-				glBegin(GL_QUADS);
-				glVertex3f(i,j,0.0);
-				glNormal3f(i,j,0.0);
-				glVertex3f(i+1,j,0.0);
-				glNormal3f(i+1,j,0.0);
-				glVertex3f(i+1,j+1,0.0);
-				glNormal3f(i+1,j+1,0.0);
-				glVertex3f(i,j+1,0.0);
-				glNormal3f(i,j+1,0.0);
-				glEnd();	
-		}
-	}*/
 	
 	glColor3f(0.36,0.55,0.16);
 	
 	
 		glScalef(3.0, 2.0,0.5);
-	for(int k = 0; k< 7; k++){
-		glTranslatef(1.5,0.0,0.0);
-		sphere();
-	}
-	glTranslatef(-10.5,1.2,0.0);
-	for(int k = 0; k< 7; k++){
-		glTranslatef(1.5,0.0,0.0);
-		sphere();
-	}
-	glTranslatef(-10.5,1.2,0.0);
-	for(int k = 0; k< 7; k++){
-		glTranslatef(1.5,0.0,0.0);
-		sphere();
-	}
-	glTranslatef(-10.5,1.2,0.0);
-	for(int k = 0; k< 7; k++){
-		glTranslatef(1.5,0.0,0.0);
-		sphere();
-	}
-	glTranslatef(-10.5,1.2,0.0);
-	for(int k = 0; k< 7; k++){
-		glTranslatef(1.5,0.0,0.0);
-		sphere();
-	}
-	
-	//glColor3f(1.0,0.0,0.0);
-	glTranslatef(-10.5,-6.0,0.0);
-	for(int k = 0; k< 7; k++){
-		glTranslatef(1.5,0.0,0.0);
-		sphere();
-	}
-	glTranslatef(-10.5,-1.2,0.0);
-	for(int k = 0; k< 7; k++){
-		glTranslatef(1.5,0.0,0.0);
-		sphere();
-	}
-	glTranslatef(-10.5,-1.2,0.0);
-	for(int k = 0; k< 7; k++){
-		glTranslatef(1.5,0.0,0.0);
-		sphere();
-	}
-	glTranslatef(-10.5,-1.2,0.0);
-	for(int k = 0; k< 7; k++){
-		glTranslatef(1.5,0.0,0.0);
-		sphere();
-	}
-	glTranslatef(-10.5,-1.2,0.0);
-	for(int k = 0; k< 7; k++){
-		glTranslatef(1.5,0.0,0.0);
-		sphere();
-	}
+	if(sol.estVide()) construirePlan(sol);
+	sol.dessiner();
 
 }
 
@@ -526,9 +95,53 @@ Tissu drap(20,10,55,50); // creation d'un tissu
 Vec3 ball_pos(10,-5,2.5); // centre de la balle
 Vec3 cube_pos(16, -5, 1.5); // centre du cube
 float ball_radius = 2; // rayon de la balle
-float ball_time = 0; // pour calculer la position en z de la balle
 float cube_size = 2.0; // taille du cube
 int ball = 0; // pour savoir si on dessine la balle ou non
+Collisionneurs objets; // objets avec lesquels le tissu entre en collision
+RenduTissu rendu; // buffers OpenGL du tissu
+int objet_balle = objets.ajouterSphere(ball_pos, ball_radius);
+
+/* la balle fait des allers-retours en z, un pas de simulation apres l'autre */
+Vec3 positionBalle(long pas){
+	Vec3 pos = ball_pos;
+	pos.f[2] = cos(pas/50.0)*7;
+	return pos;
+}
+
+long ball_time = 0; // pas faits par le thread de simulation
+
+/* un etat sauve sans objets (ou avec d'autres) ne laisse pas forcement la balle de la
+ scene a l'indice attendu : on l'ajoute au registre si elle y manque */
+void completerObjets(){
+	if(objet_balle >= objets.getNbObjets() || objets.get(objet_balle).type != COLLISION_SPHERE){
+		objet_balle = objets.ajouterSphere(positionBalle(ball_time), ball_radius);
+		objets.get(objet_balle).actif = (ball == 1);
+	}
+	objets.miseAJour();
+}
+Enregistreur enregistreur; // trajectoire du tissu ('e'), sur le thread de simulation
+Exportateur exportateur; // maillages PLY du tissu ('o'), sur le thread de simulation
+
+/* un pas de simulation (sur le thread de simulation) : deplacement de la balle, gravite,
+ vent, position des particules au pas suivant, collisions avec les objets puis du tissu
+ avec lui-meme (si active avec 'c') */
+void pasSimulation(){
+	ball_time++;
+	objets.get(objet_balle).centre = positionBalle(ball_time);
+	objets.miseAJour();
+	float dt2 = drap.getParams().time_stepsize2;
+	drap.doFrame(Vec3(0,-0.2,0)*dt2, Vec3(0.5,0,0.2)*dt2, objets);
+	if(enregistreur.estOuvert()) enregistreur.ajouterImage(drap);
+	if(exportateur.estOuvert()){
+		drap.calculerNormales();
+		exportateur.ajouterImage(drap);
+	}
+}
+
+PoolThreads pool(std::max(1, (int) std::thread::hardware_concurrency()-1)); // la simulation laisse un coeur a l'affichage
+Simulation simulation(drap, 1/60.0, pasSimulation); // 60 pas par seconde, quel que soit l'affichage
+Relecture relecture; // trajectoire rejouee a la place de la simulation (fichier en argument)
+bool hud = false; // profil par-dessus la scene ('h')
 Vec3 plan_pos(-5,-13, 0);//position du plan de la scene
 
 
@@ -585,24 +198,17 @@ float *psens = &sens;
 
 // ========== DRAW ==========
 void draw(void) {
+	profileur.finImage(); // l'image precedente est finie (echange des tampons compris)
+	PROFIL_SCOPE(PROFIL_AFFICHAGE);
 
-	ball_time++;
-	//z=z+0.15;
-	ball_pos.f[2] = cos(ball_time/50.0)*7;
-
-
-	drap.addForce(Vec3(0,-0.2,0)*TIME_STEPSIZE2); // ajout de la gravite
-	
-	drap.windForce(Vec3(0.5,0,0.2)*TIME_STEPSIZE2); // calcul de la force du vent
-	drap.timeStep(); // calcul de la position de la particule a la prochaine image
-	if(ball == 1){
-		drap.ballCollision(ball_pos,ball_radius); // collision balle-tissu
-		
+	// dernier etat publie par le thread de simulation (rien a dessiner avant le premier),
+	// ou image du moment de la trajectoire rejouee
+	const Instantane *image = relecture.estOuverte() ? relecture.lire() : simulation.dernier();
+	if(!image){
+		glutPostRedisplay();
+		return;
 	}
-	
-	//drap.cubeCollision(cube_pos, cube_size, cube_pos); // collision cube-tissu
-
-	
+	Vec3 balle = positionBalle(image->pas);
 
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glLoadIdentity();
@@ -641,7 +247,7 @@ void draw(void) {
 
 	
 	
-	drap.drawShaded(); // dessin du tissu
+	rendu.dessiner(&image->sommets[0], image->large, image->hauteur); // dessin du tissu
 	
 	// dessin du plan
 	glPushMatrix(); 
@@ -652,7 +258,7 @@ void draw(void) {
 	
 	// dessin d'une sphere
 	glPushMatrix(); 
-	glTranslatef(ball_pos.f[0],ball_pos.f[1],ball_pos.f[2]); 
+	glTranslatef(balle.f[0],balle.f[1],balle.f[2]); 
 	glColor3f(0.6f,0.19f,0.8f);
 	if(ball == 1){
 		glutSolidSphere(ball_radius-0.1,50,50); 
@@ -671,6 +277,7 @@ void draw(void) {
 
 	glPopMatrix();
 	
+	if(hud) dessinerProfil(profileur);
 	glutSwapBuffers();
 	glutPostRedisplay();
 }
@@ -693,6 +300,10 @@ void reshape(int w, int h)  {
 void keyboard( unsigned char key, int x, int y ) {
 	switch ( key ) {
 		case 'q':    // pour quitter
+			simulation.arreter();
+			enregistreur.fermer();
+			exportateur.fermer();
+			profileur.fermerCsv();
 			exit ( 0 );
 			break;  
 		case 'f':
@@ -707,15 +318,60 @@ void keyboard( unsigned char key, int x, int y ) {
 			glPolygonMode(GL_FRONT_AND_BACK, GL_POINT); // Points
 			glutPostRedisplay();
 			break;
-		case 'b': // pour activer ou non le dessin de la balle
+		case 'c': // pour activer ou non les auto-collisions du tissu
+			simulation.executer([]{
+				SimParams params = drap.getParams();
+				params.epaisseur = params.epaisseur > 0 ? 0 : 0.5f;
+				drap.setParams(params);
+			});
+			glutPostRedisplay();
+			break;
+		case 'k': // sauvegarde de l'etat du tissu et des objets dans drapeau.etat
+			simulation.executer([]{ drap.sauvegarder("drapeau.etat", &objets); });
+			break;
+		case 'K': // retour au dernier etat sauvegarde (le tissu seulement)
+			simulation.executer([]{ drap.charger("drapeau.etat"); });
+			break;
+		case ' ': // relecture : pause
+			relecture.setPause(!relecture.estEnPause());
+			break;
+		case '+': // relecture : une image de plus par image affichee (saute des images)
+			relecture.setSaut(relecture.getSaut() == -1 ? 1 : relecture.getSaut()+1);
+			break;
+		case '-': // relecture : une de moins (a l'envers en dessous de 1)
+			relecture.setSaut(relecture.getSaut() == 1 ? -1 : relecture.getSaut()-1);
+			break;
+		case 'e': // pour commencer ou finir l'enregistrement des positions dans drapeau.trj
+			simulation.executer([]{
+				if(enregistreur.estOuvert()) enregistreur.fermer();
+				else enregistreur.ouvrir("drapeau.trj", drap);
+			});
+			break;
+		case 'o': // pour commencer ou finir l'export d'un maillage par pas dans drapeau_00000.ply...
+			simulation.executer([]{
+				if(exportateur.estOuvert()) exportateur.fermer();
+				else exportateur.ouvrir("drapeau_%05d.ply", FORMAT_PLY);
+			});
+			break;
+		case 'h': // pour afficher ou non le profil (ms par phase, images par seconde)
+			hud = !hud;
+			break;
+		case 'H': // pour commencer ou finir l'ecriture du profil de chaque image dans profil.csv
+			if(profileur.estCsvOuvert()) profileur.fermerCsv();
+			else profileur.ouvrirCsv("profil.csv");
+			break;
+		case 'b': { // pour activer ou non la balle
 			if (ball == 0){
 				ball = 1;
 			}
 			else {
 				ball =0;
 			}
+			bool actif = (ball == 1);
+			simulation.executer([actif]{ objets.get(objet_balle).actif = actif; });
 			glutPostRedisplay();
 			break;
+		}
 			// effet de camera
 		case 'x' :
 			*px= *px+0.2;
@@ -770,6 +426,12 @@ void arrow_keys( int a_keys, int x, int y ) {
 	case GLUT_KEY_DOWN: 
 		glutReshapeWindow (1000, 700 );
 		break;
+	case GLUT_KEY_LEFT: // relecture : une seconde en arriere
+		relecture.aller(relecture.getImage() - (long)(1/simulation.getPeriode()));
+		break;
+	case GLUT_KEY_RIGHT: // relecture : une seconde en avant
+		relecture.aller(relecture.getImage() + (long)(1/simulation.getPeriode()));
+		break;
 	default:
 		break;
 	}
@@ -782,6 +444,9 @@ int main ( int argc, char** argv ) {
 	glutInitDisplayMode( GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH ); 
 	glutInitWindowSize(1000, 700 ); 
 
+	drap.setPool(&pool);
+	objets.get(objet_balle).actif = (ball == 1);
+
 	glutCreateWindow( "Collision sphere" );
 	init();
 	glutDisplayFunc(draw);  
@@ -789,5 +454,18 @@ int main ( int argc, char** argv ) {
 	glutKeyboardFunc(keyboard);
 	glutSpecialFunc(arrow_keys);
 
+	// avec un fichier .trj en argument, on rejoue l'enregistrement au lieu de simuler ;
+	// avec un etat sauvegarde ('k'), la simulation repart de cet etat
+	if(argc > 1 && strstr(argv[1], ".trj")){
+		if(!relecture.ouvrir(argv[1], simulation.getPeriode(), &pool)) return 1;
+	}
+	else {
+		if(argc > 1){
+			if(!drap.charger(argv[1], &objets)) return 1;
+			completerObjets();
+			ball = objets.get(objet_balle).actif ? 1 : 0;
+		}
+		simulation.demarrer();
+	}
 	glutMainLoop();
 }
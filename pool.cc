@@ -0,0 +1,180 @@
+#include "pool.h"
+
+// ========== POOL DE THREADS ==========
+
+#define ESSAIS_AVANT_ATTENTE 2000
+
+/* pool et file du thread courant : les threads du pool ont chacun la leur, les autres
+ threads (ou ceux d'un autre pool) partagent la file 0 */
+static thread_local const PoolThreads *pool_courant = 0;
+static thread_local int file_courante = 0;
+
+PoolThreads::PoolThreads(int nb_threads) : files(0), nb_files(0), nb_taches(0), nb_poussees(0), dormeurs(0), arret(false){
+	if(nb_threads <= 0) nb_threads = std::thread::hardware_concurrency();
+	if(nb_threads <= 0) nb_threads = 1;
+	nb_files = nb_threads;
+	files = new File[nb_files];
+	for(int i=1; i<nb_threads; i++){
+		threads.push_back(std::thread(&PoolThreads::boucleThread, this, i));
+	}
+}
+
+PoolThreads::~PoolThreads(){
+	{
+		std::lock_guard<std::mutex> garde(verrou);
+		arret = true;
+	}
+	reveil.notify_all();
+	for(size_t i=0; i<threads.size(); i++) threads[i].join();
+	delete[] files;
+}
+
+int PoolThreads::fileCourante() const {
+	return pool_courant == this ? file_courante : 0;
+}
+
+/* reveille les threads endormis (nouvelle tache ou groupe termine). Le compteur d'abord,
+ les dormeurs ensuite : un thread qui s'endort compte d'abord parmi les dormeurs puis
+ verifie s'il reste du travail, l'un des deux voit donc l'autre. */
+void PoolThreads::reveiller(){
+	if(dormeurs.load() == 0) return;
+	std::lock_guard<std::mutex> garde(verrou);
+	reveil.notify_all();
+}
+
+void PoolThreads::pousser(int file, const Tache &tache){
+	{
+		std::lock_guard<std::mutex> garde(files[file].verrou);
+		files[file].taches.push_back(tache);
+	}
+	nb_taches++;
+	nb_poussees++;
+	reveiller();
+}
+
+bool PoolThreads::prendre(int file, Tache &tache){
+	std::lock_guard<std::mutex> garde(files[file].verrou);
+	if(files[file].taches.empty()) return false;
+	tache = files[file].taches.back();
+	files[file].taches.pop_back();
+	nb_taches--;
+	return true;
+}
+
+bool PoolThreads::voler(int file, Tache &tache){
+	if(nb_taches.load() == 0) return false;
+	for(int k=1; k<nb_files; k++){
+		File &victime = files[(file+k)%nb_files];
+		std::lock_guard<std::mutex> garde(victime.verrou);
+		if(victime.taches.empty()) continue;
+		tache = victime.taches.front();
+		victime.taches.pop_front();
+		nb_taches--;
+		return true;
+	}
+	return false;
+}
+
+/* une tache du groupe, la plus recente de notre file ou sinon la plus ancienne (la plus
+ grosse) d'une autre file ; les taches des autres groupes restent a leur place */
+bool PoolThreads::prendreDuGroupe(int file, const Groupe *groupe, Tache &tache){
+	if(nb_taches.load() == 0) return false;
+	for(int k=0; k<nb_files; k++){
+		File &f = files[(file+k)%nb_files];
+		std::lock_guard<std::mutex> garde(f.verrou);
+		for(size_t t=0; t<f.taches.size(); t++){
+			size_t i = k == 0 ? f.taches.size()-1-t : t;
+			if(f.taches[i].groupe != groupe) continue;
+			tache = f.taches[i];
+			f.taches.erase(f.taches.begin()+i);
+			nb_taches--;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* coupe la tache en deux tant qu'elle fait plus d'un morceau (la moitie haute dans la
+ file), puis execute le premier morceau */
+void PoolThreads::executer(int file, Tache tache){
+	for(;;){
+		int nb_morceaux = (tache.fin - tache.debut + tache.taille_morceau - 1)/tache.taille_morceau;
+		if(nb_morceaux <= 1) break;
+		Tache haute = tache;
+		haute.debut = tache.debut + (nb_morceaux/2)*tache.taille_morceau;
+		tache.fin = haute.debut;
+		pousser(file, haute);
+	}
+	tache.fonction(tache.contexte, tache.debut, tache.fin);
+	int nb = tache.fin - tache.debut;
+	if(tache.groupe->restants.fetch_sub(nb) == nb) reveiller(); // dernier morceau du groupe
+}
+
+void PoolThreads::boucleThread(int file){
+	pool_courant = this;
+	file_courante = file;
+	for(;;){
+		Tache tache;
+		if(prendre(file, tache) || voler(file, tache)){
+			executer(file, tache);
+			continue;
+		}
+		// attente active courte : pendant la resolution des liens les travaux se suivent de pres
+		for(int essai=0; essai<ESSAIS_AVANT_ATTENTE && nb_taches.load() == 0; essai++){
+			std::this_thread::yield();
+		}
+		if(nb_taches.load() != 0) continue;
+		std::unique_lock<std::mutex> verrouille(verrou);
+		dormeurs++;
+		while(!arret && nb_taches.load() == 0) reveil.wait(verrouille);
+		dormeurs--;
+		if(arret) return;
+	}
+}
+
+void PoolThreads::lancer(int n, int grain, FonctionMorceau fonction, void *contexte){
+	if(n <= 0) return;
+	if(grain < 1) grain = 1;
+	// petit travail ou pas de threads : on fait tout ici
+	if(threads.empty() || n <= grain){
+		fonction(contexte, 0, n);
+		return;
+	}
+
+	// au moins 'grain' elements par morceau, et quelques morceaux par thread pour equilibrer
+	int nb_threads = getNbThreads();
+	int taille = (n + 4*nb_threads - 1)/(4*nb_threads);
+	if(taille < grain) taille = grain;
+
+	Groupe groupe;
+	groupe.restants.store(n);
+	Tache tache;
+	tache.fonction = fonction;
+	tache.contexte = contexte;
+	tache.debut = 0;
+	tache.fin = n;
+	tache.taille_morceau = taille;
+	tache.groupe = &groupe;
+	int file = fileCourante();
+	executer(file, tache);
+
+	// en attendant les morceaux pris par les autres, on n'execute que ceux du groupe : une
+	// tache d'un autre groupe (le pas d'un autre tissu) pourrait durer bien plus longtemps
+	// et s'empilerait sur celle-ci. Seul un morceau du groupe, en se coupant, en pousse
+	// d'autres : on dort jusqu'a la fin du groupe ou la prochaine tache poussee.
+	while(groupe.restants.load() != 0){
+		unsigned vues = nb_poussees.load();
+		if(prendreDuGroupe(file, &groupe, tache)){
+			executer(file, tache);
+			continue;
+		}
+		for(int essai=0; essai<ESSAIS_AVANT_ATTENTE && groupe.restants.load() != 0 && nb_poussees.load() == vues; essai++){
+			std::this_thread::yield();
+		}
+		if(groupe.restants.load() == 0 || nb_poussees.load() != vues) continue;
+		std::unique_lock<std::mutex> verrouille(verrou);
+		dormeurs++;
+		while(groupe.restants.load() != 0 && nb_poussees.load() == vues) reveil.wait(verrouille);
+		dormeurs--;
+	}
+}
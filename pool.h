@@ -0,0 +1,89 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/* Pool de threads a vol de travail pour les boucles paralleles du tissu (et du monde).
+ parallelFor decoupe [0, n) en morceaux d'au moins 'grain' elements ; l'appel ne retourne
+ que lorsque tous les morceaux sont faits. Chaque thread a sa file de taches : un
+ intervalle est coupe en deux, la moitie haute va dans la file (ou un thread libre peut la
+ voler), et le thread continue sur la moitie basse. Un parallelFor lance depuis une tache
+ (les liens d'un grand tissu, dans le pas d'un monde) produit donc lui aussi des taches
+ que les autres threads peuvent prendre. En attendant la fin de ses morceaux, le thread
+ appelant n'execute que des morceaux de ce meme parallelFor : un tissu qui attend ses
+ liens ne fait pas le pas d'un autre tissu sur sa pile, la profondeur d'imbrication reste
+ celle du code et la duree d'un appel ne compte que son propre travail. */
+class PoolThreads {
+public:
+	typedef void (*FonctionMorceau)(void *contexte, int debut, int fin);
+
+private:
+	/* morceaux d'un meme parallelFor : termine quand restants (elements) arrive a 0 */
+	struct Groupe {
+		std::atomic<int> restants;
+	};
+
+	struct Tache {
+		FonctionMorceau fonction;
+		void *contexte;
+		int debut, fin;
+		int taille_morceau; // on coupe l'intervalle jusqu'a cette taille
+		Groupe *groupe;
+	};
+
+	/* file d'un thread : le proprietaire prend a la fin (le plus petit, le plus recent),
+	 les voleurs au debut (les plus gros morceaux) */
+	struct File {
+		std::mutex verrou;
+		std::deque<Tache> taches;
+	};
+
+	std::vector<std::thread> threads;
+	File *files; // une par thread du pool, et la 0 pour les threads exterieurs
+	int nb_files;
+	std::atomic<int> nb_taches; // taches en attente dans toutes les files
+	std::atomic<unsigned> nb_poussees; // taches poussees depuis le debut : reveille ceux qui attendent un groupe
+
+	std::mutex verrou;
+	std::condition_variable reveil; // nouvelle tache, groupe termine ou arret
+	std::atomic<int> dormeurs; // threads en attente sur reveil
+	bool arret;
+
+	void boucleThread(int file);
+	void pousser(int file, const Tache &tache);
+	bool prendre(int file, Tache &tache);
+	bool voler(int file, Tache &tache);
+	bool prendreDuGroupe(int file, const Groupe *groupe, Tache &tache);
+	void executer(int file, Tache tache);
+	void reveiller();
+	int fileCourante() const;
+
+	void lancer(int n, int grain, FonctionMorceau fonction, void *contexte);
+
+	template<class F>
+	static void appeler(void *contexte, int debut, int fin){
+		(*(const F*) contexte)(debut, fin);
+	}
+
+	PoolThreads(const PoolThreads&);
+	PoolThreads &operator=(const PoolThreads&);
+
+public:
+	/* nb_threads compte le thread appelant ; 0 = nombre de coeurs de la machine */
+	PoolThreads(int nb_threads = 0);
+	~PoolThreads();
+
+	int getNbThreads() const { return (int) threads.size() + 1; }
+
+	template<class F>
+	void parallelFor(int n, int grain, const F &f){
+		lancer(n, grain, &appeler<F>, (void*) &f);
+	}
+};
+
+#endif
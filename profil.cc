@@ -0,0 +1,97 @@
+#include "profil.h"
+
+// ========== PROFIL ==========
+
+Profil profileur;
+
+static const char *noms_phases[NB_PHASES_PROFIL] = { "forces", "liens", "integration", "collisions", "auto_collisions",
+	"normales", "copie", "pas", "attente_vbo", "envoi", "dessin", "affichage" };
+
+Profil::Profil() : nb_particules(0), nb_liens(0), prochaine(0), nb_mesures(0), nb_images(0), derniere_image(Horloge::now()), csv(0) {
+	for(int p=0; p<NB_PHASES_PROFIL; p++){
+		ns[p] = 0;
+		appels[p] = 0;
+	}
+}
+
+Profil::~Profil(){
+	fermerCsv();
+}
+
+bool Profil::estCompile(){
+#ifdef TISSU_PROFIL
+	return true;
+#else
+	return false;
+#endif
+}
+
+const char *Profil::nom(PhaseProfil phase){
+	return noms_phases[phase];
+}
+
+void Profil::finImage(){
+	Horloge::time_point maintenant = Horloge::now();
+	Mesure &mesure = fenetre[prochaine];
+	for(int p=0; p<NB_PHASES_PROFIL; p++){
+		mesure.ns[p] = ns[p].exchange(0, std::memory_order_relaxed);
+		mesure.appels[p] = appels[p].exchange(0, std::memory_order_relaxed);
+	}
+	mesure.duree = std::chrono::duration<double>(maintenant - derniere_image).count();
+	derniere_image = maintenant;
+	prochaine = (prochaine+1) % FENETRE;
+	if(nb_mesures < FENETRE) nb_mesures++;
+
+	if(csv){
+		fprintf(csv, "%ld,%.3f,%llu", nb_images, mesure.duree*1e3, (unsigned long long) mesure.appels[PROFIL_PAS]);
+		for(int p=0; p<NB_PHASES_PROFIL; p++) fprintf(csv, ",%.4f", mesure.ns[p]*1e-6);
+		fprintf(csv, ",%d,%d\n", getNbParticules(), getNbLiens());
+	}
+	nb_images++;
+}
+
+double Profil::getMs(PhaseProfil phase) const {
+	uint64_t total = 0, pas = 0;
+	for(int m=0; m<nb_mesures; m++){
+		total += fenetre[m].ns[phase];
+		pas += fenetre[m].appels[PROFIL_PAS];
+	}
+	uint64_t diviseur = parPas(phase) && pas > 0 ? pas : nb_mesures;
+	return diviseur ? total*1e-6/diviseur : 0;
+}
+
+double Profil::getImagesParSeconde() const {
+	double duree = 0;
+	for(int m=0; m<nb_mesures; m++) duree += fenetre[m].duree;
+	return duree > 0 ? nb_mesures/duree : 0;
+}
+
+double Profil::getPasParSeconde() const {
+	double duree = 0;
+	uint64_t pas = 0;
+	for(int m=0; m<nb_mesures; m++){
+		duree += fenetre[m].duree;
+		pas += fenetre[m].appels[PROFIL_PAS];
+	}
+	return duree > 0 ? pas/duree : 0;
+}
+
+bool Profil::ouvrirCsv(const char *chemin){
+	fermerCsv();
+	if(!estCompile()) fprintf(stderr, "profil : compiler avec -DTISSU_PROFIL pour mesurer les phases\n");
+	csv = fopen(chemin, "w");
+	if(!csv){
+		perror(chemin);
+		return false;
+	}
+	fprintf(csv, "image,ms_image,pas");
+	for(int p=0; p<NB_PHASES_PROFIL; p++) fprintf(csv, ",ms_%s", noms_phases[p]);
+	fprintf(csv, ",particules,liens\n");
+	return true;
+}
+
+void Profil::fermerCsv(){
+	if(!csv) return;
+	fclose(csv);
+	csv = 0;
+}
@@ -0,0 +1,147 @@
+#ifndef PROFIL_H
+#define PROFIL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+/* Temps passe dans chaque phase d'un pas du tissu et de l'affichage. Les chronometres
+ (PROFIL_SCOPE) n'existent que si tout est compile avec -DTISSU_PROFIL : sans ce drapeau
+ les macros ne laissent rien dans le code et le profil reste vide. */
+
+/* phases de la simulation (moyennes par pas), puis de l'affichage (par image) */
+enum PhaseProfil {
+	PROFIL_FORCES, // addForce, windForce (avec le calcul des triangles)
+	PROFIL_LIENS, // passes sur les liens
+	PROFIL_INTEGRATION, // integration de Verlet (et collisions avec les objets si fusion)
+	PROFIL_COLLISIONS, // collisions avec les objets, hors fusion
+	PROFIL_AUTO_COLLISIONS,
+	PROFIL_NORMALES, // calculerNormales
+	PROFIL_COPIE, // copierSommets
+	PROFIL_PAS, // doFrame entier : ses appels comptent les pas
+	PROFIL_ATTENTE, // attente de la moitie libre du VBO
+	PROFIL_ENVOI, // copie et envoi des sommets a la carte
+	PROFIL_DESSIN, // appels de dessin du tissu
+	PROFIL_AFFICHAGE, // draw() entier
+	NB_PHASES_PROFIL
+};
+
+// ========== PROFIL ==========
+/* Les chronometres ajoutent leur duree par operations atomiques, depuis n'importe quel
+ thread (simulation, pool, affichage) : avec plusieurs threads (un Monde), c'est la somme
+ de leurs temps. finImage(), appele par l'affichage a chaque image, releve les totaux
+ depuis l'image precedente, les garde dans une fenetre glissante (le HUD) et les ecrit
+ dans le CSV s'il est ouvert. */
+class Profil {
+public:
+	enum { FENETRE = 60 }; // images moyennees par le HUD
+
+private:
+	typedef std::chrono::steady_clock Horloge;
+
+	struct Mesure {
+		uint64_t ns[NB_PHASES_PROFIL];
+		uint64_t appels[NB_PHASES_PROFIL];
+		double duree; // secondes depuis l'image precedente
+	};
+
+	std::atomic<uint64_t> ns[NB_PHASES_PROFIL], appels[NB_PHASES_PROFIL];
+	std::atomic<int> nb_particules, nb_liens;
+
+	// au thread d'affichage
+	Mesure fenetre[FENETRE];
+	int prochaine, nb_mesures;
+	long nb_images;
+	Horloge::time_point derniere_image;
+	FILE *csv;
+
+	Profil(const Profil&);
+	Profil &operator=(const Profil&);
+
+public:
+	Profil();
+	~Profil();
+
+	static bool estCompile(); // vrai si profil.cc est compile avec TISSU_PROFIL
+	static const char *nom(PhaseProfil phase);
+	static bool parPas(PhaseProfil phase) { return phase < PROFIL_ATTENTE; }
+
+	void ajouter(PhaseProfil phase, uint64_t duree_ns){
+		ns[phase].fetch_add(duree_ns, std::memory_order_relaxed);
+		appels[phase].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void setTaille(int particules, int liens){
+		nb_particules.store(particules, std::memory_order_relaxed);
+		nb_liens.store(liens, std::memory_order_relaxed);
+	}
+
+	void finImage();
+
+	/* moyennes sur la fenetre : ms par pas pour les phases de simulation (par image s'il
+	 n'y a pas eu de pas, en relecture), ms par image pour l'affichage */
+	double getMs(PhaseProfil phase) const;
+	double getImagesParSeconde() const;
+	double getPasParSeconde() const;
+	int getNbParticules() const { return nb_particules.load(std::memory_order_relaxed); }
+	int getNbLiens() const { return nb_liens.load(std::memory_order_relaxed); }
+
+	/* une ligne par image : duree, pas faits, ms de chaque phase (totaux de l'image) */
+	bool ouvrirCsv(const char *chemin);
+	void fermerCsv();
+	bool estCsvOuvert() const { return csv != 0; }
+};
+
+extern Profil profileur; // "profil" est deja une fonction de unistd.h
+
+/* ajoute au profil le temps passe entre sa construction et sa destruction */
+class ChronoProfil {
+private:
+	PhaseProfil phase;
+	std::chrono::steady_clock::time_point debut;
+
+public:
+	explicit ChronoProfil(PhaseProfil phase) : phase(phase), debut(std::chrono::steady_clock::now()) {}
+	~ChronoProfil(){
+		profileur.ajouter(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - debut).count());
+	}
+};
+
+/* recoit le debut et la fin des passes sur les liens (PROFIL_LIENS) et de l'integration
+ (PROFIL_INTEGRATION) d'un Tissu qui l'a recu par setObservateur, avec ou sans
+ TISSU_PROFIL : le banc d'essai y lit ses compteurs materiels pour chacune a part */
+class ObservateurPhases {
+public:
+	virtual ~ObservateurPhases() {}
+	virtual void debut(PhaseProfil phase) = 0;
+	virtual void fin(PhaseProfil phase) = 0;
+};
+
+/* previent l'observateur (s'il y en a un) a sa construction et a sa destruction */
+class ObservationPhase {
+private:
+	ObservateurPhases *observateur;
+	PhaseProfil phase;
+
+public:
+	ObservationPhase(ObservateurPhases *observateur, PhaseProfil phase) : observateur(observateur), phase(phase) {
+		if(observateur) observateur->debut(phase);
+	}
+	~ObservationPhase(){
+		if(observateur) observateur->fin(phase);
+	}
+};
+
+#define PROFIL_CONCATENER2(a, b) a##b
+#define PROFIL_CONCATENER(a, b) PROFIL_CONCATENER2(a, b)
+
+#ifdef TISSU_PROFIL
+#define PROFIL_SCOPE(phase) ChronoProfil PROFIL_CONCATENER(chrono_profil_, __LINE__)(phase)
+#define PROFIL_TAILLE(particules, liens) profileur.setTaille(particules, liens)
+#else
+#define PROFIL_SCOPE(phase) ((void) 0)
+#define PROFIL_TAILLE(particules, liens) ((void) 0)
+#endif
+
+#endif
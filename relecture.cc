@@ -0,0 +1,168 @@
+#include "relecture.h"
+
+// ========== RELECTURE ==========
+
+#define AVANCE 8 // images decodees a l'avance
+#define NB_CASES (AVANCE + 2) // + l'image affichee et celle que l'on decode
+
+Relecture::Relecture() : tissu(0), affichee(-1), nb_images(0), cible(0), saut(1), erreur(false), arret(false), periode(1/60.0), pause(false), image_depart(0) {}
+
+Relecture::~Relecture(){
+	fermer();
+}
+
+bool Relecture::ouvrir(const char *chemin, double periode, PoolThreads *pool){
+	fermer();
+	if(!lecteur.ouvrir(chemin)) return false;
+	if(lecteur.getNbImages() == 0 || lecteur.getLarge()*lecteur.getHauteur() != lecteur.getNbParticules()){
+		lecteur.fermer();
+		return false;
+	}
+	tissu = new Tissu(lecteur.getLarge(), lecteur.getHauteur()); // grille seule, sans liens
+	tissu->setPool(pool);
+	positions.resize(3*(size_t) lecteur.getNbParticules());
+
+	cases.assign(NB_CASES, Case());
+	for(int c=0; c<NB_CASES; c++){
+		cases[c].numero = -1;
+		cases[c].prete = false;
+	}
+	affichee = -1;
+	nb_images = lecteur.getNbImages();
+	cible = 0;
+	saut = 1;
+	erreur = false;
+	arret = false;
+	this->periode = periode;
+	pause = false;
+	recaler(0);
+	thread = std::thread(&Relecture::boucle, this);
+	return true;
+}
+
+void Relecture::fermer(){
+	if(!tissu) return;
+	{
+		std::lock_guard<std::mutex> garde(verrou);
+		arret = true;
+	}
+	changement.notify_all();
+	thread.join();
+	delete tissu;
+	tissu = 0;
+	lecteur.fermer();
+	cases.clear();
+}
+
+long Relecture::voulue(int k) const {
+	long n = (cible + (long) k*saut) % nb_images;
+	return n < 0 ? n + nb_images : n;
+}
+
+int Relecture::chercher(long numero) const {
+	for(int c=0; c<NB_CASES; c++){
+		if(cases[c].numero == numero) return c;
+	}
+	return -1;
+}
+
+void Relecture::decoder(Case &c, long numero){
+	if(!lecteur.lireImage(numero, &positions[0])){
+		std::lock_guard<std::mutex> garde(verrou);
+		erreur = true;
+		return;
+	}
+	tissu->placerPositions(&positions[0]);
+	tissu->calculerNormales();
+	c.image.sommets.resize(6*(size_t) tissu->getNbParticules());
+	tissu->copierSommets(&c.image.sommets[0]);
+	c.image.large = tissu->getNbParticulesLarge();
+	c.image.hauteur = tissu->getNbParticulesHauteur();
+	c.image.pas = numero;
+}
+
+/* decode la premiere image voulue qui manque, dans une case qui n'est ni affichee ni voulue */
+void Relecture::boucle(){
+	std::unique_lock<std::mutex> verrouille(verrou);
+	while(!arret){
+		long numero = -1;
+		for(int k=0; k<AVANCE && numero < 0; k++){
+			if(chercher(voulue(k)) < 0) numero = voulue(k);
+		}
+		if(numero < 0 || erreur){
+			changement.wait(verrouille);
+			continue;
+		}
+		int libre = -1;
+		for(int c=0; c<NB_CASES && libre < 0; c++){
+			if(c == affichee) continue;
+			bool garder = false;
+			for(int j=0; j<AVANCE && !garder; j++) garder = cases[c].numero == voulue(j);
+			if(!garder) libre = c;
+		}
+		Case &c = cases[libre];
+		c.numero = numero;
+		c.prete = false;
+		long suivante = voulue(AVANCE);
+		int sens = saut;
+		verrouille.unlock();
+
+		decoder(c, numero);
+		// le bloc des images qui suivent celles que l'on garde (et le precedent a l'envers)
+		long bloc = lecteur.getImagesParBloc();
+		long debut = suivante - suivante % bloc;
+		lecteur.precharger(sens > 0 ? debut : debut - bloc, debut + bloc - 1);
+
+		verrouille.lock();
+		c.prete = true;
+		changement.notify_all();
+	}
+}
+
+/* l'horloge repart de image maintenant */
+void Relecture::recaler(long image){
+	image %= nb_images;
+	image_depart = image < 0 ? image + nb_images : image;
+	depart = Horloge::now();
+}
+
+long Relecture::getImage(){
+	if(!tissu) return 0;
+	if(pause) return image_depart;
+	long ecoulees = (long)(std::chrono::duration<double>(Horloge::now() - depart).count()/periode);
+	long n = (image_depart + ecoulees*saut) % nb_images;
+	return n < 0 ? n + nb_images : n;
+}
+
+const Instantane *Relecture::lire(){
+	if(!tissu) return 0;
+	long n = getImage();
+	std::unique_lock<std::mutex> verrouille(verrou);
+	if(cible != n){
+		cible = n;
+		changement.notify_all();
+	}
+	int c;
+	while(!erreur && ((c = chercher(n)) < 0 || !cases[c].prete)) changement.wait(verrouille);
+	if(erreur) return 0;
+	affichee = c;
+	return &cases[c].image;
+}
+
+void Relecture::aller(long image){
+	if(tissu) recaler(image);
+}
+
+void Relecture::setPause(bool pause){
+	if(!tissu) return;
+	recaler(getImage());
+	this->pause = pause;
+}
+
+void Relecture::setSaut(int saut){
+	if(!tissu || saut == 0) return;
+	recaler(getImage());
+	std::lock_guard<std::mutex> garde(verrou);
+	this->saut = saut;
+	changement.notify_all();
+}
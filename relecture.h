@@ -0,0 +1,86 @@
+#ifndef RELECTURE_H
+#define RELECTURE_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "tissu.h"
+#include "simulation.h"
+#include "trajectoire.h"
+
+// ========== RELECTURE ==========
+/* Rejoue une trajectoire enregistree (Enregistreur) sans refaire la simulation : un
+ thread de prechargement decode les images qui vont etre affichees (l'image en cours
+ et les AVANCE suivantes, de saut en saut) en Instantane prets a dessiner, positions et
+ normales comme pendant la simulation, et demande au systeme les blocs du fichier qui
+ suivent. L'affichage ne fait que prendre l'image du moment avec lire().
+
+ L'image affichee avance d'un saut toutes les periodes (saut > 1 : on saute des images,
+ saut < 0 : a l'envers) et revient au debut a la fin du fichier. aller() deplace la
+ lecture n'importe ou ; il faut alors attendre le decodage d'une image (au plus un bloc). */
+class Relecture {
+private:
+	typedef std::chrono::steady_clock Horloge;
+
+	struct Case {
+		Instantane image;
+		long numero; // image decodee dans la case, -1 si libre
+		bool prete;
+	};
+
+	// au thread de prechargement
+	LecteurTrajectoire lecteur;
+	Tissu *tissu; // porte les positions relues pour calculer les normales
+	std::vector<float> positions;
+
+	std::vector<Case> cases;
+	int affichee; // case rendue par le dernier lire(), jamais reutilisee avant le suivant
+	long nb_images;
+	long cible; // image a afficher, le thread decode a partir de celle-ci
+	int saut;
+	bool erreur, arret;
+	std::mutex verrou;
+	std::condition_variable changement;
+	std::thread thread;
+
+	// horloge de lecture (thread d'affichage)
+	double periode;
+	bool pause;
+	Horloge::time_point depart;
+	long image_depart;
+
+	void boucle();
+	long voulue(int k) const; // k-ieme image a precharger a partir de cible
+	int chercher(long numero) const;
+	void decoder(Case &c, long numero);
+	void recaler(long image);
+
+	Relecture(const Relecture&);
+	Relecture &operator=(const Relecture&);
+
+public:
+	Relecture();
+	~Relecture();
+
+	/* periode : temps d'affichage d'une image (celle de la simulation enregistree) ;
+	 le pool sert au calcul des normales */
+	bool ouvrir(const char *chemin, double periode = 1/60.0, PoolThreads *pool = 0);
+	void fermer();
+	bool estOuverte() const { return tissu != 0; }
+
+	/* image du moment, valable jusqu'au prochain appel ; 0 si le fichier est illisible */
+	const Instantane *lire();
+
+	long getImage(); // image du moment
+	long getNbImages() const { return nb_images; }
+
+	void aller(long image);
+	void setPause(bool pause);
+	bool estEnPause() const { return pause; }
+	void setSaut(int saut);
+	int getSaut() const { return saut; }
+};
+
+#endif
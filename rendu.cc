@@ -0,0 +1,286 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "opengl.h"
+#include "rendu.h"
+
+#define FLOATS_PAR_SOMMET 6 // position puis normale, comme Tissu::copierSommets
+
+// ========== RENDU DU TISSU ==========
+
+/* glBufferStorage et les barrieres (glFenceSync) : OpenGL 4.4, ou les extensions */
+static bool stockagePersistantDisponible(){
+#ifdef GL_MAP_PERSISTENT_BIT
+	const char *version = (const char*) glGetString(GL_VERSION);
+	const char *extensions = (const char*) glGetString(GL_EXTENSIONS);
+	int majeur = 0, mineur = 0;
+	if(version) sscanf(version, "%d.%d", &majeur, &mineur);
+	bool stockage = majeur > 4 || (majeur == 4 && mineur >= 4) || (extensions && strstr(extensions, "GL_ARB_buffer_storage"));
+	bool barrieres = majeur > 3 || (majeur == 3 && mineur >= 2) || (extensions && strstr(extensions, "GL_ARB_sync"));
+	return stockage && barrieres;
+#else
+	return false; // en-tetes trop anciens (mac : OpenGL 2.1)
+#endif
+}
+
+RenduTissu::RenduTissu() : large(0), hauteur(0), vbo_indices(0), vbo_sommets(0), nb_indices(0), taille_image(0), projection(0), moitie(0) {
+	barrieres[0] = barrieres[1] = 0;
+}
+
+void RenduTissu::liberer(){
+	if(!large) return;
+#ifdef GL_MAP_PERSISTENT_BIT
+	for(int m=0; m<2; m++){
+		if(barrieres[m]) glDeleteSync((GLsync) barrieres[m]);
+		barrieres[m] = 0;
+	}
+	if(projection){
+		glBindBuffer(GL_ARRAY_BUFFER, vbo_sommets);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		projection = 0;
+	}
+#endif
+	glDeleteBuffers(1, &vbo_indices);
+	glDeleteBuffers(1, &vbo_sommets);
+	std::vector<float>().swap(copie);
+	large = hauteur = 0;
+}
+
+void RenduTissu::preparer(int nouvelle_large, int nouvelle_hauteur){
+	liberer();
+	large = nouvelle_large;
+	hauteur = nouvelle_hauteur;
+
+	// les deux triangles de chaque case, dans le meme ordre que calculerNormales
+	// (meme numerotation que Tissu::index : y*large + x)
+	std::vector<uint32_t> indices;
+	indices.reserve(6*(size_t)(large-1)*(hauteur-1));
+	for(int y=0; y<hauteur-1; y++){
+		for(int x=0; x<large-1; x++){
+			uint32_t i = y*large + x; // (x,y)
+			uint32_t triangles[6] = { i+1, i, i+large, i+large+1, i+1, i+large };
+			indices.insert(indices.end(), triangles, triangles+6);
+		}
+	}
+	nb_indices = (int) indices.size();
+	glGenBuffers(1, &vbo_indices);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_indices);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(uint32_t), &indices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	taille_image = FLOATS_PAR_SOMMET*sizeof(float)*(size_t)large*hauteur;
+	glGenBuffers(1, &vbo_sommets);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_sommets);
+#ifdef GL_MAP_PERSISTENT_BIT
+	if(stockagePersistantDisponible()){
+		GLbitfield drapeaux = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, 2*taille_image, 0, drapeaux);
+		projection = (float*) glMapBufferRange(GL_ARRAY_BUFFER, 0, 2*taille_image, drapeaux);
+	}
+#endif
+	if(!projection){
+		glBufferData(GL_ARRAY_BUFFER, 2*taille_image, 0, GL_STREAM_DRAW);
+		copie.resize(FLOATS_PAR_SOMMET*(size_t)large*hauteur);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	moitie = 0;
+}
+
+/* ou ecrire les sommets de l'image : la moitie libre du VBO projete, ou la copie */
+float *RenduTissu::debutImage(int nouvelle_large, int nouvelle_hauteur){
+	if(nouvelle_large != large || nouvelle_hauteur != hauteur) preparer(nouvelle_large, nouvelle_hauteur);
+	if(!projection) return &copie[0];
+#ifdef GL_MAP_PERSISTENT_BIT
+	if(barrieres[moitie]){ // la carte a fini de lire cette moitie (image d'avant-hier)
+		PROFIL_SCOPE(PROFIL_ATTENTE);
+		while(glClientWaitSync((GLsync) barrieres[moitie], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+		glDeleteSync((GLsync) barrieres[moitie]);
+		barrieres[moitie] = 0;
+	}
+#endif
+	return projection + moitie*taille_image/sizeof(float);
+}
+
+/* envoi des sommets (sauf en mode persistant, ou ils y sont deja) puis dessin */
+void RenduTissu::finImage(const float *sommets){
+	size_t debut = moitie*taille_image;
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_sommets);
+	if(!projection){
+		PROFIL_SCOPE(PROFIL_ENVOI);
+		glBufferSubData(GL_ARRAY_BUFFER, debut, taille_image, sommets);
+	}
+
+	// dessin de tous les triangles en un appel
+	PROFIL_SCOPE(PROFIL_DESSIN);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_indices);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_FLOAT, FLOATS_PAR_SOMMET*sizeof(float), (const void*) debut);
+	glNormalPointer(GL_FLOAT, FLOATS_PAR_SOMMET*sizeof(float), (const void*) (debut+3*sizeof(float)));
+	glColor3f(0.69f,0.13f,0.13f);
+	glDrawElements(GL_TRIANGLES, nb_indices, GL_UNSIGNED_INT, 0);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+#ifdef GL_MAP_PERSISTENT_BIT
+	if(projection) barrieres[moitie] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+	moitie = 1-moitie;
+}
+
+void RenduTissu::dessiner(Tissu &tissu){
+	tissu.calculerNormales();
+	float *sommets = debutImage(tissu.getNbParticulesLarge(), tissu.getNbParticulesHauteur());
+	tissu.copierSommets(sommets);
+	finImage(sommets);
+}
+
+void RenduTissu::dessiner(const float *sommets, int nouvelle_large, int nouvelle_hauteur){
+	float *image = debutImage(nouvelle_large, nouvelle_hauteur);
+	if(projection){
+		PROFIL_SCOPE(PROFIL_ENVOI);
+		memcpy(image, sommets, taille_image);
+	}
+	else image = (float*) sommets; // envoye directement par glBufferSubData
+	finImage(image);
+}
+
+// ========== GEOMETRIE FIXE ==========
+
+/* glGenBuffers et compagnie : OpenGL 1.5, ou l'extension ARB */
+static bool vboDisponibles(){
+	const char *version = (const char*) glGetString(GL_VERSION);
+	const char *extensions = (const char*) glGetString(GL_EXTENSIONS);
+	int majeur = 0, mineur = 0;
+	if(version) sscanf(version, "%d.%d", &majeur, &mineur);
+	return majeur > 1 || (majeur == 1 && mineur >= 5) || (extensions && strstr(extensions, "GL_ARB_vertex_buffer_object"));
+}
+
+MaillageFixe::MaillageFixe() : vbo_sommets(0), vbo_indices(0), liste(0), envoye(false) {}
+
+int MaillageFixe::ajouterSommet(const Vec3 &pos, const Vec3 &normal){
+	sommets.insert(sommets.end(), pos.f, pos.f+3);
+	sommets.insert(sommets.end(), normal.f, normal.f+3);
+	envoye = false;
+	return (int) (sommets.size()/FLOATS_PAR_SOMMET) - 1;
+}
+
+void MaillageFixe::ajouterTriangle(int a, int b, int c){
+	indices.push_back(a);
+	indices.push_back(b);
+	indices.push_back(c);
+	envoye = false;
+}
+
+void MaillageFixe::liberer(){
+	if(vbo_sommets){
+		glDeleteBuffers(1, &vbo_sommets);
+		glDeleteBuffers(1, &vbo_indices);
+		vbo_sommets = vbo_indices = 0;
+	}
+	if(liste){
+		glDeleteLists(liste, 1);
+		liste = 0;
+	}
+	envoye = false;
+}
+
+void MaillageFixe::dessiner(){
+	if(indices.empty()) return;
+	if(!envoye){
+		liberer();
+		if(vboDisponibles()){
+			glGenBuffers(1, &vbo_sommets);
+			glBindBuffer(GL_ARRAY_BUFFER, vbo_sommets);
+			glBufferData(GL_ARRAY_BUFFER, sommets.size()*sizeof(float), &sommets[0], GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			glGenBuffers(1, &vbo_indices);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_indices);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		}
+		else {
+			liste = glGenLists(1);
+			glNewList(liste, GL_COMPILE);
+			glBegin(GL_TRIANGLES);
+			for(size_t i=0; i<indices.size(); i++){
+				const float *sommet = &sommets[FLOATS_PAR_SOMMET*(size_t)indices[i]];
+				glNormal3fv(sommet+3);
+				glVertex3fv(sommet);
+			}
+			glEnd();
+			glEndList();
+		}
+		envoye = true;
+	}
+
+	if(liste){
+		glCallList(liste);
+		return;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_sommets);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_indices);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_FLOAT, FLOATS_PAR_SOMMET*sizeof(float), (const void*) 0);
+	glNormalPointer(GL_FLOAT, FLOATS_PAR_SOMMET*sizeof(float), (const void*) (3*sizeof(float)));
+	glDrawElements(GL_TRIANGLES, (int) indices.size(), GL_UNSIGNED_INT, 0);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// ========== PROFIL ==========
+
+static void ecrireLigne(int x, int y, const char *texte){
+	glRasterPos2i(x, y);
+	for(; *texte; texte++) glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *texte);
+}
+
+/* en haut a gauche de la fenetre, en pixels, sans eclairage ni profondeur ni brouillard */
+void dessinerProfil(const Profil &profil){
+	GLint vue[4];
+	glGetIntegerv(GL_VIEWPORT, vue);
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_FOG);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, vue[2], vue[3], 0, -1, 1); // y vers le bas
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	glColor3f(1, 1, 0.6f);
+
+	char ligne[128];
+	int y = 18;
+	snprintf(ligne, sizeof(ligne), "%.1f images/s  %.1f pas/s  %d particules  %d liens", profil.getImagesParSeconde(),
+		profil.getPasParSeconde(), profil.getNbParticules(), profil.getNbLiens());
+	ecrireLigne(10, y, ligne);
+	y += 15;
+	if(!Profil::estCompile()){
+		ecrireLigne(10, y, "phases : compiler avec -DTISSU_PROFIL");
+		y += 15;
+	}
+	else {
+		for(int p=0; p<NB_PHASES_PROFIL; p++){
+			PhaseProfil phase = (PhaseProfil) p;
+			snprintf(ligne, sizeof(ligne), "%-16s %7.3f ms/%s", Profil::nom(phase), profil.getMs(phase), Profil::parPas(phase) ? "pas" : "image");
+			ecrireLigne(10, y, ligne);
+			y += 15;
+		}
+	}
+	if(profil.estCsvOuvert()) ecrireLigne(10, y, "csv : profil.csv");
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopAttrib();
+}
@@ -0,0 +1,80 @@
+#ifndef RENDU_H
+#define RENDU_H
+
+#include <vector>
+#include <stddef.h>
+#include "tissu.h"
+#include "profil.h"
+
+// ========== RENDU DU TISSU ==========
+/* Dessin du tissu par tableaux de sommets (VBO), sans glBegin/glEnd :
+ - les indices des triangles (la grille ne change pas) sont envoyes une seule fois ;
+ - positions et normales sont recopiees a chaque image dans un VBO a deux moities :
+ on ecrit dans l'une pendant que la carte lit l'autre (une barriere par moitie).
+ Avec OpenGL 4.4 ou ARB_buffer_storage, le VBO reste projete en memoire (persistant
+ et coherent) et le tissu y ecrit directement ; sinon chaque image est envoyee par
+ glBufferSubData. Les buffers sont crees au premier dessin (le contexte doit exister). */
+class RenduTissu {
+private:
+	int large, hauteur; // grille pour laquelle les buffers sont faits (0 : pas encore crees)
+	unsigned int vbo_indices, vbo_sommets; // GLuint
+	int nb_indices;
+	size_t taille_image; // octets d'une moitie du VBO
+	float *projection; // VBO projete en memoire (mode persistant), 0 sinon
+	void *barrieres[2]; // GLsync de la derniere image dessinee depuis chaque moitie
+	int moitie; // moitie a remplir a la prochaine image
+	std::vector<float> copie; // sommets de l'image, quand le VBO n'est pas projete
+
+	void preparer(int large, int hauteur);
+	float *debutImage(int large, int hauteur);
+	void finImage(const float *sommets);
+
+public:
+	RenduTissu();
+
+	/* calcule les normales du tissu et le dessine (couleur, eclairage : etat OpenGL courant) */
+	void dessiner(Tissu &tissu);
+
+	/* dessine des sommets deja calcules (6 floats par particule, comme Tissu::copierSommets),
+	 par exemple un instantane publie par le thread de simulation */
+	void dessiner(const float *sommets, int large, int hauteur);
+
+	/* detruit les buffers (contexte courant necessaire) ; ils seront recrees au prochain dessin */
+	void liberer();
+
+	bool estPersistant() const { return projection != 0; }
+};
+
+// ========== GEOMETRIE FIXE ==========
+/* Maillage qui ne change pas (decor) : sommets et triangles donnes une fois, envoyes
+ a la carte au premier dessin dans un VBO (OpenGL 1.5), ou a defaut compiles dans une
+ display list, puis dessines en un appel sans aucun calcul a chaque image. */
+class MaillageFixe {
+private:
+	std::vector<float> sommets; // 6 floats par sommet : position puis normale
+	std::vector<unsigned int> indices; // 3 par triangle
+	unsigned int vbo_sommets, vbo_indices; // GLuint
+	unsigned int liste; // display list, quand les VBO ne sont pas disponibles
+	bool envoye;
+
+public:
+	MaillageFixe();
+
+	/* retourne l'indice du sommet, a utiliser dans ajouterTriangle */
+	int ajouterSommet(const Vec3 &pos, const Vec3 &normal);
+	void ajouterTriangle(int a, int b, int c);
+	bool estVide() const { return indices.empty(); }
+
+	void dessiner();
+
+	/* detruit les buffers (contexte courant necessaire) ; les sommets sont gardes et
+	 renvoyes au prochain dessin */
+	void liberer();
+};
+
+// ========== PROFIL ==========
+/* HUD du profil : images et pas par seconde, taille du tissu et ms de chaque phase
+ (moyennes sur les dernieres images), par-dessus l'image en cours */
+void dessinerProfil(const Profil &profil);
+
+#endif
@@ -0,0 +1,354 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "simd.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* Les versions vectorielles n'utilisent pas de FMA : chaque operation est arrondie
+ comme dans la version scalaire, toutes les versions donnent donc le meme resultat.
+ (avec gcc, la cible avx512f active aussi fma : on interdit la contraction a*b+c) */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize ("fp-contract=off")
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized" // faux positif dans avx512fintrin.h (_mm512_undefined_ps)
+#endif
+
+// ========== VERSION SCALAIRE ==========
+static void integrerScalaire(const FluxIntegration &f, int debut, int fin, float amortissement, float dt2){
+	for(int i=debut; i<fin; i++){
+		bool mobile = f.inv_mass[i] != 0;
+		float x = f.pos_x[i], y = f.pos_y[i], z = f.pos_z[i];
+		float nx = x + (x-f.old_x[i])*amortissement + (f.acc_x[i] + f.gravite[0]*f.inv_mass[i])*dt2;
+		float ny = y + (y-f.old_y[i])*amortissement + (f.acc_y[i] + f.gravite[1]*f.inv_mass[i])*dt2;
+		float nz = z + (z-f.old_z[i])*amortissement + (f.acc_z[i] + f.gravite[2]*f.inv_mass[i])*dt2;
+		f.pos_x[i] = mobile ? nx : x;
+		f.pos_y[i] = mobile ? ny : y;
+		f.pos_z[i] = mobile ? nz : z;
+		f.old_x[i] = mobile ? x : f.old_x[i];
+		f.old_y[i] = mobile ? y : f.old_y[i];
+		f.old_z[i] = mobile ? z : f.old_z[i];
+		if(f.garder_acceleration) continue;
+		f.acc_x[i] = 0;
+		f.acc_y[i] = 0;
+		f.acc_z[i] = 0;
+	}
+}
+
+static void evaluerLiensScalaire(const FluxLiens &f, int debut, int fin){
+	for(int l=debut; l<fin; l++){
+		const uint32_t *lien = f.liens + 3*(size_t)l;
+		uint32_t p1 = lien[0], p2 = lien[1];
+		float rest_distance;
+		memcpy(&rest_distance, lien+2, sizeof(float));
+		float dx = f.pos_x[p2]-f.pos_x[p1];
+		float dy = f.pos_y[p2]-f.pos_y[p1];
+		float dz = f.pos_z[p2]-f.pos_z[p1];
+		float k = 1 - rest_distance/sqrtf(dx*dx+dy*dy+dz*dz);
+		f.corr_x[l] = dx*k*0.5f;
+		f.corr_y[l] = dy*k*0.5f;
+		f.corr_z[l] = dz*k*0.5f;
+	}
+}
+
+/* meme calcul que Vec3::cross et Vec3::normalized */
+static void trianglesScalaire(const FluxTriangles &f, int debut, int fin){
+	for(int i=debut; i<fin; i++){
+		int coins[2][3] = { { i+1, i, i+f.large }, { i+f.large+1, i+1, i+f.large } };
+		for(int t=0; t<2; t++){
+			int p1 = coins[t][0], p2 = coins[t][1], p3 = coins[t][2];
+			float v1x = f.pos_x[p2]-f.pos_x[p1], v1y = f.pos_y[p2]-f.pos_y[p1], v1z = f.pos_z[p2]-f.pos_z[p1];
+			float v2x = f.pos_x[p3]-f.pos_x[p1], v2y = f.pos_y[p3]-f.pos_y[p1], v2z = f.pos_z[p3]-f.pos_z[p1];
+			float nx = v1y*v2z - v1z*v2y;
+			float ny = v1z*v2x - v1x*v2z;
+			float nz = v1x*v2y - v1y*v2x;
+			f.normal_x[t][i] = nx;
+			f.normal_y[t][i] = ny;
+			f.normal_z[t][i] = nz;
+			float l = sqrtf(nx*nx+ny*ny+nz*nz);
+			f.unitaire_x[t][i] = nx/l;
+			f.unitaire_y[t][i] = ny/l;
+			f.unitaire_z[t][i] = nz/l;
+		}
+	}
+}
+
+#ifdef SIMD_X86
+
+// ========== VERSION SSE ==========
+static inline __m128 choisirSse(__m128 masque, __m128 si_vrai, __m128 si_faux){
+	return _mm_or_ps(_mm_and_ps(masque, si_vrai), _mm_andnot_ps(masque, si_faux));
+}
+
+__attribute__((target("sse2")))
+static void integrerSse(const FluxIntegration &f, int debut, int fin, float amortissement, float dt2){
+	const __m128 a = _mm_set1_ps(amortissement);
+	const __m128 d = _mm_set1_ps(dt2);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 g[3] = { _mm_set1_ps(f.gravite[0]), _mm_set1_ps(f.gravite[1]), _mm_set1_ps(f.gravite[2]) };
+	int i = debut;
+	for(; i+4<=fin; i+=4){
+		__m128 m = _mm_loadu_ps(f.inv_mass+i);
+		__m128 mobile = _mm_cmpneq_ps(m, zero);
+		float *pos[3] = { f.pos_x+i, f.pos_y+i, f.pos_z+i };
+		float *old[3] = { f.old_x+i, f.old_y+i, f.old_z+i };
+		float *acc[3] = { f.acc_x+i, f.acc_y+i, f.acc_z+i };
+		for(int c=0; c<3; c++){
+			__m128 p = _mm_loadu_ps(pos[c]);
+			__m128 o = _mm_loadu_ps(old[c]);
+			__m128 ac = _mm_add_ps(_mm_loadu_ps(acc[c]), _mm_mul_ps(g[c], m));
+			__m128 n = _mm_add_ps(_mm_add_ps(p, _mm_mul_ps(_mm_sub_ps(p, o), a)), _mm_mul_ps(ac, d));
+			_mm_storeu_ps(pos[c], choisirSse(mobile, n, p));
+			_mm_storeu_ps(old[c], choisirSse(mobile, p, o));
+			if(!f.garder_acceleration) _mm_storeu_ps(acc[c], zero);
+		}
+	}
+	integrerScalaire(f, i, fin, amortissement, dt2);
+}
+
+/* pas de gather en SSE : les positions sont chargees une par une */
+__attribute__((target("sse2")))
+static void evaluerLiensSse(const FluxLiens &f, int debut, int fin){
+	const __m128 un = _mm_set1_ps(1.0f);
+	const __m128 demi = _mm_set1_ps(0.5f);
+	int l = debut;
+	for(; l+4<=fin; l+=4){
+		const uint32_t *lien = f.liens + 3*(size_t)l;
+		__m128 d[3];
+		const float *pos[3] = { f.pos_x, f.pos_y, f.pos_z };
+		for(int c=0; c<3; c++){
+			__m128 a = _mm_setr_ps(pos[c][lien[0]], pos[c][lien[3]], pos[c][lien[6]], pos[c][lien[9]]);
+			__m128 b = _mm_setr_ps(pos[c][lien[1]], pos[c][lien[4]], pos[c][lien[7]], pos[c][lien[10]]);
+			d[c] = _mm_sub_ps(b, a);
+		}
+		float r[4];
+		for(int k=0; k<4; k++) memcpy(r+k, lien+3*k+2, sizeof(float));
+		__m128 longueur = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], d[0]), _mm_mul_ps(d[1], d[1])), _mm_mul_ps(d[2], d[2])));
+		__m128 k = _mm_sub_ps(un, _mm_div_ps(_mm_loadu_ps(r), longueur));
+		_mm_storeu_ps(f.corr_x+l, _mm_mul_ps(_mm_mul_ps(d[0], k), demi));
+		_mm_storeu_ps(f.corr_y+l, _mm_mul_ps(_mm_mul_ps(d[1], k), demi));
+		_mm_storeu_ps(f.corr_z+l, _mm_mul_ps(_mm_mul_ps(d[2], k), demi));
+	}
+	evaluerLiensScalaire(f, l, fin);
+}
+
+__attribute__((target("sse2")))
+static void trianglesSse(const FluxTriangles &f, int debut, int fin){
+	const float *pos[3] = { f.pos_x, f.pos_y, f.pos_z };
+	int i = debut;
+	for(; i+4<=fin; i+=4){
+		int coins[2][3] = { { i+1, i, i+f.large }, { i+f.large+1, i+1, i+f.large } };
+		for(int t=0; t<2; t++){
+			__m128 v1[3], v2[3];
+			for(int c=0; c<3; c++){
+				__m128 p1 = _mm_loadu_ps(pos[c]+coins[t][0]);
+				v1[c] = _mm_sub_ps(_mm_loadu_ps(pos[c]+coins[t][1]), p1);
+				v2[c] = _mm_sub_ps(_mm_loadu_ps(pos[c]+coins[t][2]), p1);
+			}
+			__m128 nx = _mm_sub_ps(_mm_mul_ps(v1[1], v2[2]), _mm_mul_ps(v1[2], v2[1]));
+			__m128 ny = _mm_sub_ps(_mm_mul_ps(v1[2], v2[0]), _mm_mul_ps(v1[0], v2[2]));
+			__m128 nz = _mm_sub_ps(_mm_mul_ps(v1[0], v2[1]), _mm_mul_ps(v1[1], v2[0]));
+			_mm_storeu_ps(f.normal_x[t]+i, nx);
+			_mm_storeu_ps(f.normal_y[t]+i, ny);
+			_mm_storeu_ps(f.normal_z[t]+i, nz);
+			__m128 l = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+			_mm_storeu_ps(f.unitaire_x[t]+i, _mm_div_ps(nx, l));
+			_mm_storeu_ps(f.unitaire_y[t]+i, _mm_div_ps(ny, l));
+			_mm_storeu_ps(f.unitaire_z[t]+i, _mm_div_ps(nz, l));
+		}
+	}
+	trianglesScalaire(f, i, fin);
+}
+
+// ========== VERSION AVX2 ==========
+__attribute__((target("avx2")))
+static void integrerAvx2(const FluxIntegration &f, int debut, int fin, float amortissement, float dt2){
+	const __m256 a = _mm256_set1_ps(amortissement);
+	const __m256 d = _mm256_set1_ps(dt2);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 g[3] = { _mm256_set1_ps(f.gravite[0]), _mm256_set1_ps(f.gravite[1]), _mm256_set1_ps(f.gravite[2]) };
+	int i = debut;
+	for(; i+8<=fin; i+=8){
+		__m256 m = _mm256_loadu_ps(f.inv_mass+i);
+		__m256 mobile = _mm256_cmp_ps(m, zero, _CMP_NEQ_UQ);
+		float *pos[3] = { f.pos_x+i, f.pos_y+i, f.pos_z+i };
+		float *old[3] = { f.old_x+i, f.old_y+i, f.old_z+i };
+		float *acc[3] = { f.acc_x+i, f.acc_y+i, f.acc_z+i };
+		for(int c=0; c<3; c++){
+			__m256 p = _mm256_loadu_ps(pos[c]);
+			__m256 o = _mm256_loadu_ps(old[c]);
+			__m256 ac = _mm256_add_ps(_mm256_loadu_ps(acc[c]), _mm256_mul_ps(g[c], m));
+			__m256 n = _mm256_add_ps(_mm256_add_ps(p, _mm256_mul_ps(_mm256_sub_ps(p, o), a)), _mm256_mul_ps(ac, d));
+			_mm256_storeu_ps(pos[c], _mm256_blendv_ps(p, n, mobile));
+			_mm256_storeu_ps(old[c], _mm256_blendv_ps(o, p, mobile));
+			if(!f.garder_acceleration) _mm256_storeu_ps(acc[c], zero);
+		}
+	}
+	integrerSse(f, i, fin, amortissement, dt2);
+}
+
+__attribute__((target("avx2")))
+static void evaluerLiensAvx2(const FluxLiens &f, int debut, int fin){
+	const __m256 un = _mm256_set1_ps(1.0f);
+	const __m256 demi = _mm256_set1_ps(0.5f);
+	const __m256i decalages = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	int l = debut;
+	for(; l+8<=fin; l+=8){
+		const int *lien = (const int*) (f.liens + 3*(size_t)l);
+		__m256i p1 = _mm256_i32gather_epi32(lien, decalages, 4);
+		__m256i p2 = _mm256_i32gather_epi32(lien+1, decalages, 4);
+		__m256 rest_distance = _mm256_i32gather_ps((const float*) (lien+2), decalages, 4);
+		__m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(f.pos_x, p2, 4), _mm256_i32gather_ps(f.pos_x, p1, 4));
+		__m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(f.pos_y, p2, 4), _mm256_i32gather_ps(f.pos_y, p1, 4));
+		__m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(f.pos_z, p2, 4), _mm256_i32gather_ps(f.pos_z, p1, 4));
+		__m256 longueur = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+		__m256 k = _mm256_sub_ps(un, _mm256_div_ps(rest_distance, longueur));
+		_mm256_storeu_ps(f.corr_x+l, _mm256_mul_ps(_mm256_mul_ps(dx, k), demi));
+		_mm256_storeu_ps(f.corr_y+l, _mm256_mul_ps(_mm256_mul_ps(dy, k), demi));
+		_mm256_storeu_ps(f.corr_z+l, _mm256_mul_ps(_mm256_mul_ps(dz, k), demi));
+	}
+	evaluerLiensSse(f, l, fin);
+}
+
+__attribute__((target("avx2")))
+static void trianglesAvx2(const FluxTriangles &f, int debut, int fin){
+	const float *pos[3] = { f.pos_x, f.pos_y, f.pos_z };
+	int i = debut;
+	for(; i+8<=fin; i+=8){
+		int coins[2][3] = { { i+1, i, i+f.large }, { i+f.large+1, i+1, i+f.large } };
+		for(int t=0; t<2; t++){
+			__m256 v1[3], v2[3];
+			for(int c=0; c<3; c++){
+				__m256 p1 = _mm256_loadu_ps(pos[c]+coins[t][0]);
+				v1[c] = _mm256_sub_ps(_mm256_loadu_ps(pos[c]+coins[t][1]), p1);
+				v2[c] = _mm256_sub_ps(_mm256_loadu_ps(pos[c]+coins[t][2]), p1);
+			}
+			__m256 nx = _mm256_sub_ps(_mm256_mul_ps(v1[1], v2[2]), _mm256_mul_ps(v1[2], v2[1]));
+			__m256 ny = _mm256_sub_ps(_mm256_mul_ps(v1[2], v2[0]), _mm256_mul_ps(v1[0], v2[2]));
+			__m256 nz = _mm256_sub_ps(_mm256_mul_ps(v1[0], v2[1]), _mm256_mul_ps(v1[1], v2[0]));
+			_mm256_storeu_ps(f.normal_x[t]+i, nx);
+			_mm256_storeu_ps(f.normal_y[t]+i, ny);
+			_mm256_storeu_ps(f.normal_z[t]+i, nz);
+			__m256 l = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz)));
+			_mm256_storeu_ps(f.unitaire_x[t]+i, _mm256_div_ps(nx, l));
+			_mm256_storeu_ps(f.unitaire_y[t]+i, _mm256_div_ps(ny, l));
+			_mm256_storeu_ps(f.unitaire_z[t]+i, _mm256_div_ps(nz, l));
+		}
+	}
+	trianglesSse(f, i, fin);
+}
+
+// ========== VERSION AVX-512 ==========
+__attribute__((target("avx512f")))
+static void integrerAvx512(const FluxIntegration &f, int debut, int fin, float amortissement, float dt2){
+	const __m512 a = _mm512_set1_ps(amortissement);
+	const __m512 d = _mm512_set1_ps(dt2);
+	const __m512 zero = _mm512_setzero_ps();
+	const __m512 g[3] = { _mm512_set1_ps(f.gravite[0]), _mm512_set1_ps(f.gravite[1]), _mm512_set1_ps(f.gravite[2]) };
+	int i = debut;
+	for(; i+16<=fin; i+=16){
+		__m512 m = _mm512_loadu_ps(f.inv_mass+i);
+		__mmask16 mobile = _mm512_cmp_ps_mask(m, zero, _CMP_NEQ_UQ);
+		float *pos[3] = { f.pos_x+i, f.pos_y+i, f.pos_z+i };
+		float *old[3] = { f.old_x+i, f.old_y+i, f.old_z+i };
+		float *acc[3] = { f.acc_x+i, f.acc_y+i, f.acc_z+i };
+		for(int c=0; c<3; c++){
+			__m512 p = _mm512_loadu_ps(pos[c]);
+			__m512 o = _mm512_loadu_ps(old[c]);
+			__m512 ac = _mm512_add_ps(_mm512_loadu_ps(acc[c]), _mm512_mul_ps(g[c], m));
+			__m512 n = _mm512_add_ps(_mm512_add_ps(p, _mm512_mul_ps(_mm512_sub_ps(p, o), a)), _mm512_mul_ps(ac, d));
+			_mm512_mask_storeu_ps(pos[c], mobile, n);
+			_mm512_mask_storeu_ps(old[c], mobile, p);
+			if(!f.garder_acceleration) _mm512_storeu_ps(acc[c], zero);
+		}
+	}
+	integrerAvx2(f, i, fin, amortissement, dt2);
+}
+
+__attribute__((target("avx512f")))
+static void evaluerLiensAvx512(const FluxLiens &f, int debut, int fin){
+	const __m512 un = _mm512_set1_ps(1.0f);
+	const __m512 demi = _mm512_set1_ps(0.5f);
+	const __m512i decalages = _mm512_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 33, 36, 39, 42, 45);
+	int l = debut;
+	for(; l+16<=fin; l+=16){
+		const int *lien = (const int*) (f.liens + 3*(size_t)l);
+		__m512i p1 = _mm512_i32gather_epi32(decalages, lien, 4);
+		__m512i p2 = _mm512_i32gather_epi32(decalages, lien+1, 4);
+		__m512 rest_distance = _mm512_i32gather_ps(decalages, lien+2, 4);
+		__m512 dx = _mm512_sub_ps(_mm512_i32gather_ps(p2, f.pos_x, 4), _mm512_i32gather_ps(p1, f.pos_x, 4));
+		__m512 dy = _mm512_sub_ps(_mm512_i32gather_ps(p2, f.pos_y, 4), _mm512_i32gather_ps(p1, f.pos_y, 4));
+		__m512 dz = _mm512_sub_ps(_mm512_i32gather_ps(p2, f.pos_z, 4), _mm512_i32gather_ps(p1, f.pos_z, 4));
+		__m512 longueur = _mm512_sqrt_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz)));
+		__m512 k = _mm512_sub_ps(un, _mm512_div_ps(rest_distance, longueur));
+		_mm512_storeu_ps(f.corr_x+l, _mm512_mul_ps(_mm512_mul_ps(dx, k), demi));
+		_mm512_storeu_ps(f.corr_y+l, _mm512_mul_ps(_mm512_mul_ps(dy, k), demi));
+		_mm512_storeu_ps(f.corr_z+l, _mm512_mul_ps(_mm512_mul_ps(dz, k), demi));
+	}
+	evaluerLiensAvx2(f, l, fin);
+}
+
+__attribute__((target("avx512f")))
+static void trianglesAvx512(const FluxTriangles &f, int debut, int fin){
+	const float *pos[3] = { f.pos_x, f.pos_y, f.pos_z };
+	int i = debut;
+	for(; i+16<=fin; i+=16){
+		int coins[2][3] = { { i+1, i, i+f.large }, { i+f.large+1, i+1, i+f.large } };
+		for(int t=0; t<2; t++){
+			__m512 v1[3], v2[3];
+			for(int c=0; c<3; c++){
+				__m512 p1 = _mm512_loadu_ps(pos[c]+coins[t][0]);
+				v1[c] = _mm512_sub_ps(_mm512_loadu_ps(pos[c]+coins[t][1]), p1);
+				v2[c] = _mm512_sub_ps(_mm512_loadu_ps(pos[c]+coins[t][2]), p1);
+			}
+			__m512 nx = _mm512_sub_ps(_mm512_mul_ps(v1[1], v2[2]), _mm512_mul_ps(v1[2], v2[1]));
+			__m512 ny = _mm512_sub_ps(_mm512_mul_ps(v1[2], v2[0]), _mm512_mul_ps(v1[0], v2[2]));
+			__m512 nz = _mm512_sub_ps(_mm512_mul_ps(v1[0], v2[1]), _mm512_mul_ps(v1[1], v2[0]));
+			_mm512_storeu_ps(f.normal_x[t]+i, nx);
+			_mm512_storeu_ps(f.normal_y[t]+i, ny);
+			_mm512_storeu_ps(f.normal_z[t]+i, nz);
+			__m512 l = _mm512_sqrt_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(nx, nx), _mm512_mul_ps(ny, ny)), _mm512_mul_ps(nz, nz)));
+			_mm512_storeu_ps(f.unitaire_x[t]+i, _mm512_div_ps(nx, l));
+			_mm512_storeu_ps(f.unitaire_y[t]+i, _mm512_div_ps(ny, l));
+			_mm512_storeu_ps(f.unitaire_z[t]+i, _mm512_div_ps(nz, l));
+		}
+	}
+	trianglesAvx2(f, i, fin);
+}
+
+#endif
+
+// ========== SELECTION ==========
+static const NoyauxSimd noyaux_scalaires = { "scalaire", integrerScalaire, evaluerLiensScalaire, trianglesScalaire };
+#ifdef SIMD_X86
+static const NoyauxSimd noyaux_sse = { "sse", integrerSse, evaluerLiensSse, trianglesSse };
+static const NoyauxSimd noyaux_avx2 = { "avx2", integrerAvx2, evaluerLiensAvx2, trianglesAvx2 };
+static const NoyauxSimd noyaux_avx512 = { "avx512", integrerAvx512, evaluerLiensAvx512, trianglesAvx512 };
+#endif
+
+static const NoyauxSimd *choisirNoyaux(){
+	const char *impose = getenv("TISSU_SIMD");
+	if(impose && !strcmp(impose, "scalaire")) return &noyaux_scalaires;
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	bool avx512 = __builtin_cpu_supports("avx512f");
+	bool avx2 = __builtin_cpu_supports("avx2");
+	bool sse = __builtin_cpu_supports("sse2");
+	if(impose){
+		if(!strcmp(impose, "sse") && sse) return &noyaux_sse;
+		if(!strcmp(impose, "avx2") && avx2) return &noyaux_avx2;
+		if(!strcmp(impose, "avx512") && avx512) return &noyaux_avx512;
+	}
+	if(avx512) return &noyaux_avx512;
+	if(avx2) return &noyaux_avx2;
+	if(sse) return &noyaux_sse;
+#endif
+	return &noyaux_scalaires;
+}
+
+const NoyauxSimd &noyauxSimd(){
+	static const NoyauxSimd *noyaux = choisirNoyaux();
+	return *noyaux;
+}
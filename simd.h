@@ -0,0 +1,64 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+
+/* Noyaux de calcul vectorises sur les tableaux de particules du tissu.
+ Chaque noyau existe en version scalaire, SSE, AVX2 et AVX-512 ; la meilleure
+ version supportee par le processeur est choisie au premier appel de noyauxSimd()
+ (CPUID). La variable d'environnement TISSU_SIMD (scalaire, sse, avx2, avx512)
+ permet d'imposer une version, par exemple pour comparer dans bench. */
+
+// ========== FLUX DE PARTICULES ==========
+struct FluxIntegration {
+	float *pos_x, *pos_y, *pos_z;
+	float *old_x, *old_y, *old_z;
+	float *acc_x, *acc_y, *acc_z;
+	const float *inv_mass; // 0 pour une particule immobile
+	float gravite[3]; // force ajoutee a l'acceleration de chaque particule (multipliee par inv_mass)
+	bool garder_acceleration; // sous-pas XPBD : l'acceleration sert encore aux sous-pas suivants
+};
+
+/* integration de verlet des particules [debut, fin) :
+ pos = pos + (pos-old_pos)*amortissement + (acceleration + gravite*inv_mass)*dt2, old_pos = pos,
+ acceleration = 0 (sauf garder_acceleration)
+ les particules immobiles sont masquees (leurs positions ne changent pas) */
+typedef void (*NoyauIntegration)(const FluxIntegration &flux, int debut, int fin, float amortissement, float dt2);
+
+// ========== FLUX DE LIENS (JACOBI) ==========
+struct FluxLiens {
+	const float *pos_x, *pos_y, *pos_z;
+	const uint32_t *liens; // 3 mots par lien, comme Lien dans tissu.h : p1, p2, rest_distance
+	float *corr_x, *corr_y, *corr_z; // une correction par lien
+};
+
+/* evaluation des liens [debut, fin) sur les positions courantes, sans les modifier :
+ corr = (p2-p1)*(1 - rest_distance/|p2-p1|)*0.5, a ajouter a p1 et a retrancher de p2.
+ Les versions AVX2 et AVX-512 traitent 8 et 16 liens par instruction (gather). */
+typedef void (*NoyauEvaluationLiens)(const FluxLiens &flux, int debut, int fin);
+
+// ========== FLUX DE TRIANGLES ==========
+/* chaque case (x,y) de la grille porte deux triangles, comme dans Tissu::calculerNormales :
+ haut (0) : (x+1,y) (x,y) (x,y+1) et bas (1) : (x+1,y+1) (x+1,y) (x,y+1).
+ La case (x,y) est a l'indice de sa particule (x,y), y*large + x. */
+struct FluxTriangles {
+	const float *pos_x, *pos_y, *pos_z;
+	int large; // particules par ligne
+	float *normal_x[2], *normal_y[2], *normal_z[2]; // produit vectoriel (sa longueur est le double de l'aire)
+	float *unitaire_x[2], *unitaire_y[2], *unitaire_z[2]; // la meme normale divisee par sa longueur
+};
+
+/* normales des triangles des cases [debut, fin) d'une meme ligne (x < large-1) */
+typedef void (*NoyauTriangles)(const FluxTriangles &flux, int debut, int fin);
+
+// ========== SELECTION DES NOYAUX ==========
+struct NoyauxSimd {
+	const char *nom; // "scalaire", "sse", "avx2" ou "avx512"
+	NoyauIntegration integrer;
+	NoyauEvaluationLiens evaluerLiens;
+	NoyauTriangles triangles;
+};
+
+const NoyauxSimd &noyauxSimd();
+
+#endif
@@ -0,0 +1,76 @@
+#include <chrono>
+#include "simulation.h"
+
+typedef std::chrono::steady_clock Horloge;
+
+#define RETARD_MAX 4 // pas de retard au-dela desquels on ne rattrape plus
+
+// ========== SIMULATION ==========
+
+Simulation::Simulation(Tissu &tissu, double periode, const std::function<void()> &pas)
+	: tissu(tissu), pas_simulation(pas), periode(periode), continuer(false), nb_pas(0), recu(false) {}
+
+Simulation::~Simulation(){
+	arreter();
+}
+
+void Simulation::demarrer(){
+	if(thread.joinable()) return;
+	continuer = true;
+	thread = std::thread(&Simulation::boucle, this);
+}
+
+void Simulation::arreter(){
+	continuer = false;
+	if(thread.joinable()) thread.join();
+}
+
+void Simulation::executer(const std::function<void()> &commande){
+	std::lock_guard<std::mutex> verrouille(verrou_commandes);
+	commandes.push_back(commande);
+}
+
+void Simulation::executerCommandes(){
+	std::vector<std::function<void()> > a_faire;
+	{
+		std::lock_guard<std::mutex> verrouille(verrou_commandes);
+		a_faire.swap(commandes);
+	}
+	for(size_t i=0; i<a_faire.size(); i++) a_faire[i]();
+}
+
+/* normales et copie des sommets dans le tampon du producteur, puis echange */
+void Simulation::publier(){
+	Instantane &instantane = instantanes.ecriture();
+	tissu.calculerNormales();
+	instantane.sommets.resize(6*(size_t)tissu.getNbParticules());
+	tissu.copierSommets(&instantane.sommets[0]);
+	instantane.large = tissu.getNbParticulesLarge();
+	instantane.hauteur = tissu.getNbParticulesHauteur();
+	instantane.pas = nb_pas.load(std::memory_order_relaxed);
+	instantanes.publier();
+}
+
+void Simulation::boucle(){
+	Horloge::duration duree_pas = std::chrono::duration_cast<Horloge::duration>(std::chrono::duration<double>(periode));
+	executerCommandes();
+	publier(); // etat initial, pour avoir quelque chose a dessiner tout de suite
+	Horloge::time_point prochain = Horloge::now();
+	while(continuer.load(std::memory_order_relaxed)){
+		executerCommandes();
+		pas_simulation();
+		nb_pas.fetch_add(1, std::memory_order_relaxed);
+		publier();
+
+		prochain += duree_pas;
+		Horloge::time_point maintenant = Horloge::now();
+		if(maintenant > prochain + RETARD_MAX*duree_pas) prochain = maintenant; // trop lent : on abandonne le retard
+		else std::this_thread::sleep_until(prochain);
+	}
+	executerCommandes();
+}
+
+const Instantane *Simulation::dernier(){
+	if(instantanes.lire()) recu = true;
+	return recu ? &instantanes.lecture() : 0;
+}
@@ -0,0 +1,103 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include "tissu.h"
+
+// ========== TRIPLE TAMPON ==========
+/* Passage d'images d'un thread producteur a un thread lecteur sans verrou ni attente :
+ le producteur remplit ecriture() puis publier() l'echange avec le tampon du milieu ;
+ le lecteur, avec lire(), echange son tampon avec celui du milieu s'il est plus recent.
+ Chacun garde toujours un tampon a lui ; seul l'indice du milieu est partage. */
+template<class T>
+class TripleTampon {
+private:
+	enum { NOUVEAU = 4 }; // le milieu a ete publie depuis la derniere lecture
+
+	T tampons[3];
+	std::atomic<int> milieu; // indice du tampon du milieu | NOUVEAU
+	int arriere; // au producteur
+	int devant; // au lecteur
+
+public:
+	TripleTampon() : milieu(1), arriere(0), devant(2) {}
+
+	T &ecriture() { return tampons[arriere]; }
+
+	void publier(){
+		arriere = milieu.exchange(arriere | NOUVEAU, std::memory_order_acq_rel) & 3;
+	}
+
+	/* retourne faux si rien n'a ete publie depuis le dernier appel (lecture() ne change pas) */
+	bool lire(){
+		if(!(milieu.load(std::memory_order_relaxed) & NOUVEAU)) return false;
+		devant = milieu.exchange(devant, std::memory_order_acq_rel) & 3;
+		return true;
+	}
+
+	const T &lecture() const { return tampons[devant]; }
+};
+
+// ========== INSTANTANE ==========
+/* etat du tissu publie apres un pas : 6 floats par particule (position puis normale
+ normalisee, comme Tissu::copierSommets) */
+struct Instantane {
+	std::vector<float> sommets;
+	int large, hauteur;
+	long pas; // nombre de pas faits quand l'instantane a ete pris
+
+	Instantane() : large(0), hauteur(0), pas(0) {}
+};
+
+// ========== SIMULATION ==========
+/* Fait avancer un tissu sur son propre thread, a pas fixe (periode en secondes),
+ independamment de l'affichage. Chaque pas appelle la fonction donnee (forces, doFrame...)
+ puis publie un instantane que le thread d'affichage recupere sans bloquer avec
+ dernier(). Si un pas prend plus d'une periode, on continue sans chercher a rattraper
+ au-dela de quelques pas de retard.
+ Tout ce que touche la fonction de pas (tissu, objets, pool de threads) ne doit etre
+ modifie qu'a travers executer(), qui le fait sur le thread de simulation entre deux pas. */
+class Simulation {
+private:
+	Tissu &tissu;
+	std::function<void()> pas_simulation;
+	double periode;
+
+	std::thread thread;
+	std::atomic<bool> continuer;
+	std::atomic<long> nb_pas;
+
+	std::mutex verrou_commandes;
+	std::vector<std::function<void()> > commandes;
+
+	TripleTampon<Instantane> instantanes;
+	bool recu; // le lecteur a deja eu un instantane
+
+	void boucle();
+	void executerCommandes();
+	void publier();
+
+public:
+	Simulation(Tissu &tissu, double periode, const std::function<void()> &pas);
+	~Simulation();
+
+	void demarrer();
+	/* attend la fin du pas en cours ; sans effet si le thread ne tourne pas */
+	void arreter();
+
+	/* la commande sera executee sur le thread de simulation avant le prochain pas */
+	void executer(const std::function<void()> &commande);
+
+	/* pour le thread d'affichage : dernier instantane publie (0 avant le premier),
+	 valable jusqu'au prochain appel */
+	const Instantane *dernier();
+
+	long getNbPas() const { return nb_pas.load(std::memory_order_relaxed); }
+	double getPeriode() const { return periode; }
+};
+
+#endif
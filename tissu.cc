@@ -0,0 +1,1049 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include "tissu.h"
+#include "simd.h"
+#include "pool.h"
+#include "profil.h"
+
+#define GRAIN_LIENS 4096 // nombre minimum de liens par morceau parallele
+#define GRAIN_PARTICULES 16384 // nombre minimum de particules par morceau parallele
+#define GRAIN_CONTACTS 1024 // particules par morceau pour les auto-collisions (plus cheres)
+#define BLOC_FUSION 512 // particules traitees d'un coup par l'integration fusionnee (~25 Ko de tableaux)
+
+/* erreur max et somme des carres des erreurs, reunies morceau par morceau.
+ La somme est faite en virgule fixe (2^-32) : l'addition d'entiers ne depend pas de
+ l'ordre, le residu (et donc l'arret des iterations) ne depend pas du nombre de threads. */
+#define UNITE_RESIDU 4294967296.0
+#define CARRE_MAX_RESIDU 64.0f // au dela, l'erreur compte pour 8 dans la moyenne
+
+struct Residu {
+	std::mutex verrou;
+	float max;
+	uint64_t somme_carres;
+
+	Residu() : max(0), somme_carres(0) {}
+
+	static uint64_t carre(float erreur){
+		return (uint64_t) (std::min(erreur*erreur, CARRE_MAX_RESIDU)*UNITE_RESIDU);
+	}
+
+	void ajouter(float max_morceau, uint64_t somme_morceau){
+		std::lock_guard<std::mutex> garde(verrou);
+		max = std::max(max, max_morceau);
+		somme_carres += somme_morceau;
+	}
+
+	float rms(int nb) const {
+		return nb ? sqrt(somme_carres/UNITE_RESIDU/nb) : 0;
+	}
+};
+
+/* sous-pas effectifs : la vitesse (pos - old) est celle d'un sous-pas */
+static int nbSousPas(const SimParams &params){
+	return params.mode == XPBD ? std::max(1, params.sous_pas) : 1;
+}
+
+// ========== TISSU ==========
+
+static_assert(sizeof(Lien) == 12, "Lien doit rester compact");
+
+/* ordre des liens dans une couleur : par premiere particule, pour parcourir les
+ tableaux de positions dans l'ordre de la memoire */
+static bool avantDansLaMemoire(const Lien &a, const Lien &b){
+	return a.p1 < b.p1 || (a.p1 == b.p1 && a.p2 < b.p2);
+}
+
+Lien Tissu::creerLien(int p1, int p2) {
+	Lien lien;
+	lien.p1 = std::min(p1, p2);
+	lien.p2 = std::max(p1, p2);
+	lien.rest_distance = (getPos(p1)-getPos(p2)).length();
+	return lien;
+}
+
+template<class F>
+void Tissu::pourTout(int n, int grain, const F &f){
+	if(pool) pool->parallelFor(n, grain, f);
+	else f(0, n);
+}
+
+FluxIntegration Tissu::flux(){
+	FluxIntegration f;
+	f.pos_x = &pos_x[0]; f.pos_y = &pos_y[0]; f.pos_z = &pos_z[0];
+	f.old_x = &old_x[0]; f.old_y = &old_y[0]; f.old_z = &old_z[0];
+	f.acc_x = &acc_x[0]; f.acc_y = &acc_y[0]; f.acc_z = &acc_z[0];
+	f.inv_mass = &inv_mass[0];
+	f.gravite[0] = f.gravite[1] = f.gravite[2] = 0;
+	f.garder_acceleration = false;
+	return f;
+}
+
+float Tissu::lienPossible(const Lien &lien) {
+	Vec3 p1_to_p2 = getPos(lien.p2)-getPos(lien.p1); // vecteur de p1 a p2
+	float current_distance = p1_to_p2.length(); //  distance entre p1  p2
+	Vec3 correctionVector = p1_to_p2*(1 - lien.rest_distance/current_distance); // vecteur de compensation : deplace p1 d'une distance rest_distance de p2
+	Vec3 correctionVectorHalf = correctionVector*0.5; // on prend la moitie de la longueur precedente pour bouger P1 et P2
+	offsetPos(lien.p1, correctionVectorHalf); // correctionVectorHalf pointe de p1 a P2 pour que la longueur puisse bouger P2 de moitie pour satisfaire la creation des liens.
+	offsetPos(lien.p2, -correctionVectorHalf); // on deplace p2 de -direction si on va de P2 a p1 au lieu de P1 a P2	
+	return current_distance;
+}
+
+/* C = distance - rest_distance, de gradient n = (p1-p2)/distance pour p1 et -n pour p2 :
+ dlambda = (-C - alpha_tilde*lambda)/(w1 + w2 + alpha_tilde), p1 += w1*dlambda*n, p2 -= w2*dlambda*n.
+ Avec alpha_tilde = 0 et deux particules mobiles, c'est la moitie de la correction comme lienPossible.
+ Sans souplesse, lambda n'intervient pas (alpha_tilde*lambda = 0) : lambda peut etre 0. */
+float Tissu::lienXpbd(const Lien &lien, float *lambda, float alpha_tilde) {
+	Vec3 p2_to_p1 = getPos(lien.p1)-getPos(lien.p2);
+	float current_distance = p2_to_p1.length();
+	float w1 = inv_mass[lien.p1], w2 = inv_mass[lien.p2];
+	float denominateur = w1 + w2 + alpha_tilde;
+	if(denominateur == 0 || current_distance == 0) return current_distance; // deux particules immobiles
+	float k = (lien.rest_distance - current_distance - (lambda ? alpha_tilde*(*lambda) : 0))/(denominateur*current_distance); // dlambda/distance
+	if(lambda) *lambda += k*current_distance;
+	Vec3 correction = p2_to_p1*k;
+	offsetPos(lien.p1, correction);
+	offsetPos(lien.p2, -correction);
+	return current_distance;
+}
+
+/* couleurs 0-3 : horizontaux et verticaux, 4-7 : diagonales, 8-15 : liens a distance 2 */
+float Tissu::complianceCouleur(int c) const {
+	if(c < 4) return params.compliance_etirement;
+	if(c < 8) return params.compliance_cisaillement;
+	return params.compliance_flexion;
+}
+
+void Tissu::calculerTriangles(){
+	if(triangles_a_jour) return;
+	int n = getNbParticules();
+	for(int t=0; t<2; t++){
+		triangle_x[t].resize(n); triangle_y[t].resize(n); triangle_z[t].resize(n);
+		unitaire_x[t].resize(n); unitaire_y[t].resize(n); unitaire_z[t].resize(n);
+	}
+	FluxTriangles f;
+	f.pos_x = &pos_x[0]; f.pos_y = &pos_y[0]; f.pos_z = &pos_z[0];
+	f.large = nb_particules_large;
+	for(int t=0; t<2; t++){
+		f.normal_x[t] = &triangle_x[t][0]; f.normal_y[t] = &triangle_y[t][0]; f.normal_z[t] = &triangle_z[t][0];
+		f.unitaire_x[t] = &unitaire_x[t][0]; f.unitaire_y[t] = &unitaire_y[t][0]; f.unitaire_z[t] = &unitaire_z[t][0];
+	}
+	// une ligne de cases par appel du noyau, la derniere colonne n'a pas de case
+	int large = nb_particules_large;
+	pourTout(nb_particules_hauteur-1, std::max(1, GRAIN_PARTICULES/large), [&f, large](int debut, int fin){
+		for(int y=debut; y<fin; y++) noyauxSimd().triangles(f, y*large, y*large+large-1);
+	});
+	triangles_a_jour = true;
+}
+
+template<class F>
+void Tissu::pourTrianglesAutour(int x, int y, const F &f) const {
+	bool gauche = x > 0, droite = x < nb_particules_large-1;
+	bool dessus = y > 0, dessous = y < nb_particules_hauteur-1;
+	if(dessus && gauche) f(1, index(x-1,y-1)); // (x,y) est le coin (x+1,y+1)
+	if(dessus && droite){ f(0, index(x,y-1)); f(1, index(x,y-1)); } // coin (x,y+1)
+	if(dessous && gauche){ f(0, index(x-1,y)); f(1, index(x-1,y)); } // coin (x+1,y)
+	if(dessous && droite) f(0, index(x,y)); // coin (x,y)
+}
+
+Tissu::Tissu(float large, float hauteur, int nb_particules_large, int nb_particules_hauteur, const SimParams &params, Epinglage epinglage) : nb_particules_large(nb_particules_large), nb_particules_hauteur(nb_particules_hauteur), pool(0), observateur(0), params(params), distance_voisins(0), triangles_a_jour(false), iterations(0), residu_max(0), residu_rms(0){
+	int n = nb_particules_large*nb_particules_hauteur;
+	pos_x.resize(n); pos_y.resize(n); pos_z.resize(n);
+	old_x.resize(n); old_y.resize(n); old_z.resize(n);
+	acc_x.assign(n, 0); acc_y.assign(n, 0); acc_z.assign(n, 0);
+	normal_x.assign(n, 0); normal_y.assign(n, 0); normal_z.assign(n, 0);
+	inv_mass.assign(n, 1); // toutes les particules ont une masse de 1
+
+	// creation des particules dans une grille de (0,0,0) jusqu'a (largeur, hauteur, 0)
+	for(int x=0; x<nb_particules_large; x++){
+		for(int y=0; y<nb_particules_hauteur; y++){
+			int i = index(x,y); // colonne x ligne y
+			old_x[i] = pos_x[i] = large * (x/(float)nb_particules_large);
+			old_y[i] = pos_y[i] = hauteur * (y/(float)nb_particules_hauteur);
+			old_z[i] = pos_z[i] = 0;
+		}
+	}
+
+	// Connexion des particules voisines avec un lien (distance 1 et racine de 2 dans la grille)
+	// la couleur alterne d'une colonne (ou d'une ligne) a l'autre dans chaque famille
+	std::vector<Lien> couleurs[NB_COULEURS];
+	for(int x=0; x<nb_particules_large; x++){
+		for(int y=0; y<nb_particules_hauteur; y++){
+			if (x<nb_particules_large-1) couleurs[0+x%2].push_back(creerLien(index(x,y),index(x+1,y)));
+			if (y<nb_particules_hauteur-1) couleurs[2+y%2].push_back(creerLien(index(x,y),index(x,y+1)));
+			if (x<nb_particules_large-1 && y<nb_particules_hauteur-1) couleurs[4+x%2].push_back(creerLien(index(x,y),index(x+1,y+1)));
+			if (x<nb_particules_large-1 && y<nb_particules_hauteur-1) couleurs[6+x%2].push_back(creerLien(index(x+1,y),index(x,y+1)));
+		}
+	}
+
+
+	// connexion des particules presque voisines avec un lien(distance 2 et racine de 4 dans la grille
+	// ici deux colonnes sur quatre ont la meme couleur : (x, x+2) et (x+1, x+3) ne se touchent pas
+	for(int x=0; x<nb_particules_large; x++){
+		for(int y=0; y<nb_particules_hauteur; y++){
+			if (x<nb_particules_large-2) couleurs[8+(x/2)%2].push_back(creerLien(index(x,y),index(x+2,y)));
+			if (y<nb_particules_hauteur-2) couleurs[10+(y/2)%2].push_back(creerLien(index(x,y),index(x,y+2)));
+			if (x<nb_particules_large-2 && y<nb_particules_hauteur-2) couleurs[12+(x/2)%2].push_back(creerLien(index(x,y),index(x+2,y+2)));
+			if (x<nb_particules_large-2 && y<nb_particules_hauteur-2) couleurs[14+(x/2)%2].push_back(creerLien(index(x+2,y),index(x,y+2)));			}
+	}
+
+	// l'ordre a l'interieur d'une couleur ne change pas le resultat (liens independants)
+	size_t nb_liens = 0;
+	for(int c=0; c<NB_COULEURS; c++) nb_liens += couleurs[c].size();
+	liens.reserve(nb_liens);
+	for(int c=0; c<NB_COULEURS; c++){
+		std::sort(couleurs[c].begin(), couleurs[c].end(), avantDansLaMemoire);
+		debut_couleurs[c] = (int) liens.size();
+		liens.insert(liens.end(), couleurs[c].begin(), couleurs[c].end());
+		std::vector<Lien>().swap(couleurs[c]);
+	}
+	debut_couleurs[NB_COULEURS] = (int) liens.size();
+
+
+	distance_voisins = std::min(large/nb_particules_large, hauteur/nb_particules_hauteur);
+
+	switch(epinglage){
+	case EPINGLAGE_DRAPEAU:
+		// le haut gauche et droit sur 3 unites seront immobiles
+		for(int i=nb_particules_large/2.5;i<nb_particules_large; i++){
+			offsetPos(index(0+i ,0), Vec3(0.5,0.0,0.0)); // permet de rendre un effet un peu plus naturel
+			inv_mass[index(0+i ,0)] = 0; // particule immobile
+		}
+		break;
+	case EPINGLAGE_GAUCHE:
+		for(int i=nb_particules_large/2.5;i<nb_particules_large; i++){
+			offsetPos(index(nb_particules_large-1-i ,0), Vec3(-0.5,0.0,0.0));
+			inv_mass[index(nb_particules_large-1-i ,0)] = 0;
+		}
+		break;
+	case EPINGLAGE_HAUT:
+		for(int x=0; x<nb_particules_large; x++) inv_mass[index(x,0)] = 0;
+		break;
+	case EPINGLAGE_COINS:
+		inv_mass[index(0,0)] = 0;
+		inv_mass[index(nb_particules_large-1,0)] = 0;
+		break;
+	}
+}
+
+Tissu::Tissu(int nb_particules_large, int nb_particules_hauteur) : nb_particules_large(nb_particules_large), nb_particules_hauteur(nb_particules_hauteur),
+	pool(0), observateur(0), distance_voisins(0), triangles_a_jour(false), iterations(0), residu_max(0), residu_rms(0){
+	int n = nb_particules_large*nb_particules_hauteur;
+	pos_x.assign(n, 0); pos_y.assign(n, 0); pos_z.assign(n, 0);
+	normal_x.assign(n, 0); normal_y.assign(n, 0); normal_z.assign(n, 0);
+	for(int c=0; c<=NB_COULEURS; c++) debut_couleurs[c] = 0;
+}
+
+Tissu::Tissu() : nb_particules_large(0), nb_particules_hauteur(0), pool(0), observateur(0), distance_voisins(0), triangles_a_jour(false), iterations(0), residu_max(0), residu_rms(0){
+	for(int c=0; c<=NB_COULEURS; c++) debut_couleurs[c] = 0;
+}
+
+/* 	Le tissu est donc un ensemble de trinagles. pour 4 particules, on a ainsi :
+ 
+ (x,y)   *--* (x+1,y)
+ | /|
+ |/ |
+ (x,y+1) *--* (x+1,y+1)
+ 
+ */
+void Tissu::calculerNormales(){
+	PROFIL_SCOPE(PROFIL_NORMALES);
+	// les normales des triangles sont deja calculees pour le vent si les particules n'ont pas bouge depuis
+	calculerTriangles();
+	int large = nb_particules_large;
+	pourTout(nb_particules_hauteur, std::max(1, GRAIN_PARTICULES/large), [this, large](int debut, int fin){
+		for(int y=debut; y<fin; y++){
+			for(int x=0; x<large; x++){
+				Vec3 normal(0, 0, 0); // reinitialiser les normales, qui changent constamment.
+				pourTrianglesAutour(x, y, [this, &normal](int t, int c){
+					normal += triangleUnitaire(t, c);
+				});
+				int i = index(x,y);
+				normal_x[i] = normal.f[0];
+				normal_y[i] = normal.f[1];
+				normal_z[i] = normal.f[2];
+			}
+		}
+	});
+}
+
+void Tissu::copierSommets(float *sommets){
+	PROFIL_SCOPE(PROFIL_COPIE);
+	pourTout(getNbParticules(), GRAIN_PARTICULES, [this, sommets](int debut, int fin){
+		for(int i=debut; i<fin; i++){
+			Vec3 normal = getNormal(i).normalized();
+			float *sommet = sommets + 6*(size_t)i;
+			sommet[0] = pos_x[i]; sommet[1] = pos_y[i]; sommet[2] = pos_z[i];
+			sommet[3] = normal.f[0]; sommet[4] = normal.f[1]; sommet[5] = normal.f[2];
+		}
+	});
+}
+
+void Tissu::copierPositions(float *positions) const {
+	size_t n = getNbParticules();
+	memcpy(positions, &pos_x[0], n*sizeof(float));
+	memcpy(positions+n, &pos_y[0], n*sizeof(float));
+	memcpy(positions+2*n, &pos_z[0], n*sizeof(float));
+}
+
+void Tissu::placerPositions(const float *positions){
+	size_t n = getNbParticules();
+	memcpy(&pos_x[0], positions, n*sizeof(float));
+	memcpy(&pos_y[0], positions+n, n*sizeof(float));
+	memcpy(&pos_z[0], positions+2*n, n*sizeof(float));
+	if(old_x.size() == n){ // pas de positions precedentes dans une grille seule
+		old_x = pos_x; old_y = pos_y; old_z = pos_z;
+	}
+	triangles_a_jour = false;
+}
+
+Vec3 Tissu::getVitesse(int i) const {
+	float dt = sqrt(params.time_stepsize2)/nbSousPas(params);
+	return Vec3(pos_x[i]-old_x[i], pos_y[i]-old_y[i], pos_z[i]-old_z[i])/dt;
+}
+
+float Tissu::etirementMax() const {
+	float max = 0;
+	for(size_t l=0; l<liens.size(); l++){
+		const Lien &lien = liens[l];
+		max = std::max(max, ((getPos(lien.p2)-getPos(lien.p1)).length() - lien.rest_distance)/lien.rest_distance);
+	}
+	return max;
+}
+
+void Tissu::translater(const Vec3 v){
+	for(int i=0; i<getNbParticules(); i++){
+		pos_x[i] += v.f[0]; pos_y[i] += v.f[1]; pos_z[i] += v.f[2];
+		old_x[i] += v.f[0]; old_y[i] += v.f[1]; old_z[i] += v.f[2];
+	}
+	triangles_a_jour = false;
+}
+
+void Tissu::iterationGaussSeidel(bool mesurer){
+	Residu residu;
+	for(int c=0; c<NB_COULEURS; c++){ // les liens d'une meme couleur sont independants
+		const Lien *couleur = &liens[debut_couleurs[c]];
+		pourTout(debut_couleurs[c+1]-debut_couleurs[c], GRAIN_LIENS, [this, couleur, mesurer, &residu](int debut, int fin){
+			if(!mesurer){
+				for(int l=debut; l<fin; l++) lienPossible(couleur[l]);
+				return;
+			}
+			float max = 0;
+			uint64_t somme = 0;
+			for(int l=debut; l<fin; l++){
+				float erreur = fabs(lienPossible(couleur[l]) - couleur[l].rest_distance)/couleur[l].rest_distance;
+				max = std::max(max, erreur);
+				somme += Residu::carre(erreur);
+			}
+			residu.ajouter(max, somme);
+		});
+	}
+	if(mesurer){
+		residu_max = residu.max;
+		residu_rms = residu.rms(getNbLiens());
+	}
+}
+
+void Tissu::iterationXpbd(bool mesurer, float dt2){
+	Residu residu;
+	for(int c=0; c<NB_COULEURS; c++){
+		const Lien *couleur = &liens[debut_couleurs[c]];
+		float alpha_tilde = complianceCouleur(c)/dt2;
+		float *lambda_couleur = alpha_tilde != 0 ? &lambda[debut_couleurs[c]] : 0; // liens rigides : pas de multiplicateurs
+		pourTout(debut_couleurs[c+1]-debut_couleurs[c], GRAIN_LIENS, [this, couleur, lambda_couleur, alpha_tilde, mesurer, &residu](int debut, int fin){
+			if(!mesurer){
+				for(int l=debut; l<fin; l++) lienXpbd(couleur[l], lambda_couleur ? lambda_couleur+l : 0, alpha_tilde);
+				return;
+			}
+			float max = 0;
+			uint64_t somme = 0;
+			for(int l=debut; l<fin; l++){
+				float erreur = fabs(lienXpbd(couleur[l], lambda_couleur ? lambda_couleur+l : 0, alpha_tilde) - couleur[l].rest_distance)/couleur[l].rest_distance;
+				max = std::max(max, erreur);
+				somme += Residu::carre(erreur);
+			}
+			residu.ajouter(max, somme);
+		});
+	}
+	if(mesurer){
+		residu_max = residu.max;
+		residu_rms = residu.rms(getNbLiens());
+	}
+}
+
+/* liste des liens de chaque particule, dans l'ordre des liens : l'ordre des sommes
+ ne depend donc pas du decoupage entre les threads */
+void Tissu::preparerJacobi(){
+	int n = getNbParticules();
+	int nb_liens = getNbLiens();
+	corr_x.resize(nb_liens); corr_y.resize(nb_liens); corr_z.resize(nb_liens);
+
+	debut_incidents.assign(n+1, 0);
+	for(int l=0; l<nb_liens; l++){
+		debut_incidents[liens[l].p1+1]++;
+		debut_incidents[liens[l].p2+1]++;
+	}
+	for(int i=0; i<n; i++) debut_incidents[i+1] += debut_incidents[i];
+
+	incidents.resize(2*(size_t)nb_liens);
+	std::vector<uint32_t> suivant(debut_incidents.begin(), debut_incidents.end()-1);
+	for(int l=0; l<nb_liens; l++){
+		incidents[suivant[liens[l].p1]++] = 2*l;
+		incidents[suivant[liens[l].p2]++] = 2*l+1;
+	}
+
+	poids_incidents.resize(n);
+	calculerPoidsJacobi();
+}
+
+void Tissu::calculerPoidsJacobi(){
+	for(size_t i=0; i<poids_incidents.size(); i++){
+		uint32_t nb = debut_incidents[i+1]-debut_incidents[i];
+		poids_incidents[i] = nb ? inv_mass[i]*params.relaxation/nb : 0;
+	}
+}
+
+void Tissu::setParams(const SimParams &params){
+	bool relaxation_change = params.relaxation != this->params.relaxation;
+	int ancien_sous_pas = nbSousPas(this->params), nouveau_sous_pas = nbSousPas(params);
+	this->params = params;
+	if(relaxation_change) calculerPoidsJacobi();
+	if(ancien_sous_pas != nouveau_sous_pas){
+		// meme vitesse, avec un sous-pas plus long ou plus court
+		float rapport = ancien_sous_pas/(float)nouveau_sous_pas;
+		for(int i=0; i<getNbParticules(); i++){
+			old_x[i] = pos_x[i] - (pos_x[i]-old_x[i])*rapport;
+			old_y[i] = pos_y[i] - (pos_y[i]-old_y[i])*rapport;
+			old_z[i] = pos_z[i] - (pos_z[i]-old_z[i])*rapport;
+		}
+	}
+}
+
+/* en JACOBI la correction d'un lien vaut (distance - rest_distance)/2 en longueur */
+void Tissu::mesurerCorrections(){
+	Residu residu;
+	pourTout(getNbLiens(), GRAIN_LIENS, [this, &residu](int debut, int fin){
+		float max = 0;
+		uint64_t somme = 0;
+		for(int l=debut; l<fin; l++){
+			float erreur = 2*sqrt(corr_x[l]*corr_x[l] + corr_y[l]*corr_y[l] + corr_z[l]*corr_z[l])/liens[l].rest_distance;
+			max = std::max(max, erreur);
+			somme += Residu::carre(erreur);
+		}
+		residu.ajouter(max, somme);
+	});
+	residu_max = residu.max;
+	residu_rms = residu.rms(getNbLiens());
+}
+
+void Tissu::iterationJacobi(bool mesurer){
+	if(incidents.size() != 2*liens.size()) preparerJacobi();
+
+	// 1. evaluation de tous les liens sur les positions courantes (vectorisee)
+	FluxLiens f;
+	f.pos_x = &pos_x[0]; f.pos_y = &pos_y[0]; f.pos_z = &pos_z[0];
+	f.liens = (const uint32_t*) &liens[0];
+	f.corr_x = &corr_x[0]; f.corr_y = &corr_y[0]; f.corr_z = &corr_z[0];
+	pourTout(getNbLiens(), GRAIN_LIENS, [&f](int debut, int fin){
+		noyauxSimd().evaluerLiens(f, debut, fin);
+	});
+	if(mesurer) mesurerCorrections();
+
+	// 2. chaque particule rassemble les corrections de ses liens
+	pourTout(getNbParticules(), GRAIN_PARTICULES, [this](int debut, int fin){
+		for(int i=debut; i<fin; i++){
+			float sx = 0, sy = 0, sz = 0;
+			for(uint32_t k=debut_incidents[i]; k<debut_incidents[i+1]; k++){
+				uint32_t l = incidents[k] >> 1;
+				if(incidents[k] & 1){ // p2 : on retranche la correction
+					sx -= corr_x[l]; sy -= corr_y[l]; sz -= corr_z[l];
+				}
+				else {
+					sx += corr_x[l]; sy += corr_y[l]; sz += corr_z[l];
+				}
+			}
+			pos_x[i] += sx*poids_incidents[i];
+			pos_y[i] += sy*poids_incidents[i];
+			pos_z[i] += sz*poids_incidents[i];
+		}
+	});
+}
+
+/* donne l'equation force = masse*acceleration : la prochaine position est trouvee par l'integrataion de verlet*/
+void Tissu::integrer(float amortissement, float dt2, const Fusion *fusion, bool garder_acceleration){
+	if(fusion && !params.fusion){ // memes objets au meme moment, en une passe a part
+		integrer(amortissement, dt2, 0, garder_acceleration);
+		collisions(*fusion->objets);
+		return;
+	}
+	PROFIL_SCOPE(PROFIL_INTEGRATION);
+	ObservationPhase observation(observateur, PROFIL_INTEGRATION);
+	FluxIntegration f = flux();
+	f.garder_acceleration = garder_acceleration;
+	if(!fusion){
+		pourTout(getNbParticules(), GRAIN_PARTICULES, [&f, amortissement, dt2](int debut, int fin){
+			noyauxSimd().integrer(f, debut, fin, amortissement, dt2);
+		});
+		return;
+	}
+	for(int c=0; c<3; c++) f.gravite[c] = fusion->gravite.f[c]; // ajoutee par le noyau
+	pourTout(getNbParticules(), GRAIN_PARTICULES, [this, &f, amortissement, dt2, fusion](int debut, int fin){
+		for(int bloc=debut; bloc<fin; bloc+=BLOC_FUSION){
+			int fin_bloc = std::min(bloc+BLOC_FUSION, fin);
+			noyauxSimd().integrer(f, bloc, fin_bloc, amortissement, dt2);
+			collisionsMorceau(*fusion->objets, bloc, fin_bloc);
+		}
+	});
+}
+
+void Tissu::timeStepGenerique(const Fusion *fusion){
+	// iterations sur tous les liens, jusqu'a ce que l'erreur passe sous la tolerance
+	bool adaptatif = params.tolerance_max > 0 || params.tolerance_rms > 0;
+	{
+		PROFIL_SCOPE(PROFIL_LIENS);
+		ObservationPhase observation(observateur, PROFIL_LIENS);
+		for(iterations=0; iterations<params.iterations; ) {
+			bool mesurer = adaptatif || iterations == params.iterations-1;
+			if(params.mode == JACOBI) iterationJacobi(mesurer);
+			else iterationGaussSeidel(mesurer);
+			iterations++;
+			if(adaptatif && (params.tolerance_max == 0 || residu_max < params.tolerance_max) && (params.tolerance_rms == 0 || residu_rms < params.tolerance_rms)) break;
+		}
+	}
+
+	integrer(1.0f-params.damping, params.time_stepsize2, fusion);
+}
+
+/* chaque sous-pas de dt/n : les multiplicateurs repartent de 0, 'iterations' passes sur
+ les liens (moins si les tolerances sont atteintes) puis integration avec dt2/n^2 et un
+ amortissement de (1-damping)^(1/n), pour garder l'amortissement par pas. Les forces
+ (acceleration) s'appliquent a chaque sous-pas, et sont remises a 0 apres le dernier. */
+void Tissu::timeStepXpbd(const Fusion *fusion){
+	if(lambda.size() != liens.size()) lambda.resize(liens.size());
+	int n = nbSousPas(params);
+	float dt2 = params.time_stepsize2/(n*n);
+	float amortissement = pow(1.0f-params.damping, 1.0f/n);
+	bool adaptatif = params.tolerance_max > 0 || params.tolerance_rms > 0;
+	iterations = 0;
+	for(int s=0; s<n; s++){
+		{
+			PROFIL_SCOPE(PROFIL_LIENS);
+			ObservationPhase observation(observateur, PROFIL_LIENS);
+			std::fill(lambda.begin(), lambda.end(), 0.0f);
+			for(int passe=0; passe<params.iterations; passe++){
+				bool mesurer = adaptatif || (s == n-1 && passe == params.iterations-1);
+				iterationXpbd(mesurer, dt2);
+				iterations++;
+				if(adaptatif && (params.tolerance_max == 0 || residu_max < params.tolerance_max) && (params.tolerance_rms == 0 || residu_rms < params.tolerance_rms)) break;
+			}
+		}
+		integrer(amortissement, dt2, fusion, s < n-1);
+	}
+}
+
+void Tissu::pas(const Fusion *fusion){
+	triangles_a_jour = false;
+	if(params.mode == XPBD) timeStepXpbd(fusion);
+	else timeStepGenerique(fusion);
+}
+
+void Tissu::timeStep(){
+	pas(0);
+}
+
+void Tissu::doFrame(const Vec3 gravite, const Vec3 vent, const Collisionneurs &objets){
+	PROFIL_SCOPE(PROFIL_PAS);
+	PROFIL_TAILLE(getNbParticules(), getNbLiens());
+	// les objets sont traites apres chaque integration (chaque sous-pas en XPBD), par bloc
+	// avec params.fusion, en une passe a part sinon
+	Fusion fusion;
+	fusion.objets = &objets;
+	if(!params.fusion){
+		addForce(gravite);
+		windForce(vent);
+		fusion.gravite = Vec3(0, 0, 0);
+	}
+	else {
+		// la gravite n'est ajoutee qu'a l'integration : les liens ne lisent pas l'acceleration
+		windForce(vent);
+		fusion.gravite = gravite;
+	}
+	pas(&fusion);
+	autoCollisions();
+}
+
+void Tissu::addForce(const Vec3 direction){
+	PROFIL_SCOPE(PROFIL_FORCES);
+	int n = getNbParticules();
+	for(int i=0; i<n; i++){
+		acc_x[i] += direction.f[0]*inv_mass[i]; // add the forces to each particle
+		acc_y[i] += direction.f[1]*inv_mass[i];
+		acc_z[i] += direction.f[2]*inv_mass[i];
+	}
+}
+
+void Tissu::windForce(const Vec3 direction){
+	PROFIL_SCOPE(PROFIL_FORCES);
+	calculerTriangles();
+	int large = nb_particules_large;
+	pourTout(nb_particules_hauteur, std::max(1, GRAIN_PARTICULES/large), [this, large, direction](int debut, int fin){
+		for(int y=debut; y<fin; y++){
+			for(int x=0; x<large; x++){
+				int i = index(x,y);
+				Vec3 acc(acc_x[i], acc_y[i], acc_z[i]);
+				pourTrianglesAutour(x, y, [this, i, &acc, direction](int t, int c){
+					acc += forceVent(t, c, direction)*inv_mass[i];
+				});
+				acc_x[i] = acc.f[0];
+				acc_y[i] = acc.f[1];
+				acc_z[i] = acc.f[2];
+			}
+		}
+	});
+}
+
+void Tissu::ballCollision(const Vec3 center,const float radius ){
+	PROFIL_SCOPE(PROFIL_COLLISIONS);
+	triangles_a_jour = false;
+	Collisionneur balle = { COLLISION_SPHERE, center, radius, true };
+	int n = getNbParticules();
+	for(int i=0; i<n; i++){
+		Vec3 correction;
+		if(corrigerCollision(balle, getPos(i), correction)){ // particule a l'interieur de la balle
+			offsetPos(i, correction); // on met la particule a la surface de la balle
+		}
+	}
+}
+
+void Tissu::cubeCollision(const Vec3 center,const float cube_size,const Vec3 cube_pos){
+	PROFIL_SCOPE(PROFIL_COLLISIONS);
+	triangles_a_jour = false;
+	Collisionneur cube = { COLLISION_CUBE, cube_pos, cube_size, true };
+	int n = getNbParticules();
+	for(int i=0; i<n; i++){
+		Vec3 correction;
+		if(corrigerCollision(cube, getPos(i), correction)){
+			offsetPos(i, correction);
+		}
+	}
+}
+
+// ========== AUTO-COLLISIONS ==========
+
+/* voisins de chaque particule d'apres les liens, tries : refaits seulement quand les liens
+ changent (construction, charger) */
+void Tissu::preparerVoisins(){
+	int n = getNbParticules();
+	debut_voisins.assign(n+1, 0);
+	for(size_t l=0; l<liens.size(); l++){
+		debut_voisins[liens[l].p1+1]++;
+		debut_voisins[liens[l].p2+1]++;
+	}
+	for(int i=0; i<n; i++) debut_voisins[i+1] += debut_voisins[i];
+	voisins.resize(2*liens.size());
+	std::vector<uint32_t> suivant(debut_voisins.begin(), debut_voisins.end()-1);
+	for(size_t l=0; l<liens.size(); l++){
+		voisins[suivant[liens[l].p1]++] = liens[l].p2;
+		voisins[suivant[liens[l].p2]++] = liens[l].p1;
+	}
+	for(int i=0; i<n; i++) std::sort(voisins.begin()+debut_voisins[i], voisins.begin()+debut_voisins[i+1]);
+}
+
+bool Tissu::lies(int i, int j) const {
+	return std::binary_search(voisins.begin()+debut_voisins[i], voisins.begin()+debut_voisins[i+1], (uint32_t) j);
+}
+
+/* tri par comptage des particules par alveole ; les tableaux ne sont realloues que si le
+ tissu grandit. L'ordre dans une alveole est celui des indices. Avec plusieurs threads,
+ tout est parallele (voir construireGrilleParallele) ; seul, le tri simple va plus vite. */
+void Tissu::construireGrilleParticules(float taille_cellule){
+	int n = getNbParticules();
+	uint32_t nb_alveoles = 1;
+	while(nb_alveoles < 2u*n) nb_alveoles *= 2;
+	uint32_t masque = nb_alveoles-1;
+	alveoles_particules.resize(n);
+	particules_triees.resize(n);
+	if(pool && pool->getNbThreads() > 1 && n > GRAIN_PARTICULES){
+		construireGrilleParallele(taille_cellule, nb_alveoles);
+		return;
+	}
+
+	for(int i=0; i<n; i++){
+		alveoles_particules[i] = hacherCellule((int) floorf(pos_x[i]/taille_cellule), (int) floorf(pos_y[i]/taille_cellule),
+			(int) floorf(pos_z[i]/taille_cellule)) & masque;
+	}
+	debut_alveoles.assign(nb_alveoles+1, 0);
+	for(int i=0; i<n; i++) debut_alveoles[alveoles_particules[i]+1]++;
+	for(uint32_t h=0; h<nb_alveoles; h++) debut_alveoles[h+1] += debut_alveoles[h];
+	for(int i=0; i<n; i++) particules_triees[debut_alveoles[alveoles_particules[i]]++] = i;
+	// le rangement a avance chaque debut jusqu'a la fin de son alveole : on revient d'un cran
+	for(uint32_t h=nb_alveoles; h>0; h--) debut_alveoles[h] = debut_alveoles[h-1];
+	debut_alveoles[0] = 0;
+}
+
+/* le meme tri en parallele : comptage par compteurs atomiques, somme prefixe par blocs,
+ rangement atomique, puis chaque alveole est remise dans l'ordre des indices (quelques
+ particules au plus) pour que le resultat ne depende pas des threads */
+void Tissu::construireGrilleParallele(float taille_cellule, uint32_t nb_alveoles){
+	int n = getNbParticules();
+	uint32_t masque = nb_alveoles-1;
+	debut_alveoles.resize(nb_alveoles+1);
+	curseurs_alveoles.resize(nb_alveoles);
+	int nb_cases = (int) nb_alveoles+1;
+
+	pourTout(nb_cases, GRAIN_PARTICULES, [this](int debut, int fin){
+		std::fill(debut_alveoles.begin()+debut, debut_alveoles.begin()+fin, 0);
+	});
+
+	// 1. alveole de chaque particule et comptage (decale d'une case pour la somme prefixe)
+	pourTout(n, GRAIN_PARTICULES, [this, taille_cellule, masque](int debut, int fin){
+		for(int i=debut; i<fin; i++){
+			uint32_t h = hacherCellule((int) floorf(pos_x[i]/taille_cellule), (int) floorf(pos_y[i]/taille_cellule),
+				(int) floorf(pos_z[i]/taille_cellule)) & masque;
+			alveoles_particules[i] = h;
+			__atomic_fetch_add(&debut_alveoles[h+1], 1, __ATOMIC_RELAXED);
+		}
+	});
+
+	// 2. somme prefixe : chaque bloc la sienne, puis le decalage de chaque bloc
+	int nb_blocs = (nb_cases + GRAIN_PARTICULES-1)/GRAIN_PARTICULES;
+	std::vector<uint32_t> fin_blocs(nb_blocs+1, 0);
+	pourTout(nb_blocs, 1, [this, nb_cases, &fin_blocs](int premier, int dernier){
+		for(int b=premier; b<dernier; b++){
+			int fin = std::min(nb_cases, (b+1)*GRAIN_PARTICULES);
+			for(int h=b*GRAIN_PARTICULES+1; h<fin; h++) debut_alveoles[h] += debut_alveoles[h-1];
+			fin_blocs[b+1] = debut_alveoles[fin-1];
+		}
+	});
+	for(int b=0; b<nb_blocs; b++) fin_blocs[b+1] += fin_blocs[b];
+	pourTout(nb_blocs, 1, [this, nb_cases, &fin_blocs](int premier, int dernier){
+		for(int b=premier; b<dernier; b++){
+			int fin = std::min(nb_cases, (b+1)*GRAIN_PARTICULES);
+			for(int h=b*GRAIN_PARTICULES; h<fin; h++) debut_alveoles[h] += fin_blocs[b];
+		}
+	});
+	pourTout((int) nb_alveoles, GRAIN_PARTICULES, [this](int debut, int fin){
+		std::copy(debut_alveoles.begin()+debut, debut_alveoles.begin()+fin, curseurs_alveoles.begin()+debut);
+	});
+
+	// 3. rangement, dans un ordre qui depend des threads...
+	pourTout(n, GRAIN_PARTICULES, [this](int debut, int fin){
+		for(int i=debut; i<fin; i++) particules_triees[__atomic_fetch_add(&curseurs_alveoles[alveoles_particules[i]], 1, __ATOMIC_RELAXED)] = i;
+	});
+
+	// 4. ... qu'on remet dans l'ordre des indices, alveole par alveole (tri par insertion)
+	pourTout((int) nb_alveoles, GRAIN_PARTICULES, [this](int debut, int fin){
+		for(int h=debut; h<fin; h++){
+			uint32_t *premier = particules_triees.data()+debut_alveoles[h], *dernier = particules_triees.data()+debut_alveoles[h+1];
+			for(uint32_t *k=premier+1; k<dernier; k++){
+				uint32_t i = *k;
+				uint32_t *j = k;
+				for(; j>premier && j[-1] > i; j--) *j = j[-1];
+				*j = i;
+			}
+		}
+	});
+}
+
+/* les cellules font une distance entre voisins de cote et l'epaisseur n'en depasse pas :
+ chaque particule ne regarde que les cellules que touche sa sphere d'epaisseur (de 1 a 27) */
+void Tissu::autoCollisions(){
+	if(params.epaisseur <= 0) return;
+	PROFIL_SCOPE(PROFIL_AUTO_COLLISIONS);
+	triangles_a_jour = false;
+	float taille_cellule = distance_voisins;
+	float epaisseur = std::min(params.epaisseur, 1.0f)*distance_voisins;
+	int n = getNbParticules();
+	if(debut_voisins.size() != (size_t) n+1 || voisins.size() != 2*liens.size()) preparerVoisins();
+	construireGrilleParticules(taille_cellule);
+	repousse_x.resize(n); repousse_y.resize(n); repousse_z.resize(n);
+	uint32_t masque = (uint32_t) debut_alveoles.size()-2;
+
+	// 1. deplacements calcules sur les positions courantes
+	pourTout(n, GRAIN_CONTACTS, [this, taille_cellule, epaisseur, masque](int debut, int fin){
+		for(int i=debut; i<fin; i++){
+			float rx = 0, ry = 0, rz = 0;
+			int contacts = 0;
+			if(isMovable(i)){
+				Vec3 p = getPos(i);
+				int min[3], max[3];
+				for(int c=0; c<3; c++){
+					min[c] = (int) floorf((p.f[c]-epaisseur)/taille_cellule);
+					max[c] = std::min((int) floorf((p.f[c]+epaisseur)/taille_cellule), min[c]+2); // 3 au plus, malgre les arrondis
+				}
+				uint32_t vues[27]; // deux cellules peuvent partager une alveole : on ne la lit qu'une fois
+				int nb_vues = 0;
+				for(int cz=min[2]; cz<=max[2]; cz++)
+					for(int cy=min[1]; cy<=max[1]; cy++)
+						for(int cx=min[0]; cx<=max[0]; cx++){
+							uint32_t h = hacherCellule(cx, cy, cz) & masque;
+							if(std::find(vues, vues+nb_vues, h) != vues+nb_vues) continue;
+							vues[nb_vues++] = h;
+							for(uint32_t k=debut_alveoles[h]; k<debut_alveoles[h+1]; k++){
+								int j = particules_triees[k];
+								float dx = p.f[0]-pos_x[j], dy = p.f[1]-pos_y[j], dz = p.f[2]-pos_z[j];
+								float d2 = dx*dx+dy*dy+dz*dz;
+								if(d2 >= epaisseur*epaisseur || d2 == 0 || lies(i, j)) continue;
+								float d = sqrtf(d2);
+								// chacune des deux particules fait sa part, selon son inverse de masse
+								float part = (epaisseur-d)/d*inv_mass[i]/(inv_mass[i]+inv_mass[j]);
+								rx += dx*part; ry += dy*part; rz += dz*part;
+								contacts++;
+							}
+						}
+			}
+			float moyenne = contacts ? 1.0f/contacts : 0;
+			repousse_x[i] = rx*moyenne;
+			repousse_y[i] = ry*moyenne;
+			repousse_z[i] = rz*moyenne;
+		}
+	});
+
+	// 2. application
+	pourTout(n, GRAIN_PARTICULES, [this](int debut, int fin){
+		for(int i=debut; i<fin; i++){
+			pos_x[i] += repousse_x[i];
+			pos_y[i] += repousse_y[i];
+			pos_z[i] += repousse_z[i];
+		}
+	});
+}
+
+/* chaque particule ne teste que les objets inscrits dans sa cellule et ceux hors grille, dans
+ l'ordre du registre (comme une suite d'appels a ballCollision / cubeCollision dans cet ordre) :
+ les deux listes croissantes sont fusionnees */
+void Tissu::collisionsMorceau(const Collisionneurs &objets, int debut, int fin){
+	if(objets.getNbObjets() == 0) return;
+	const uint32_t *debut_toujours, *fin_toujours;
+	objets.toujoursTestes(&debut_toujours, &fin_toujours);
+	for(int i=debut; i<fin; i++){
+		if(!isMovable(i) || !objets.pres(getPos(i))) continue;
+		const uint32_t *candidat, *dernier, *grand = debut_toujours;
+		objets.candidats(getPos(i), &candidat, &dernier);
+		while(candidat != dernier || grand != fin_toujours){
+			uint32_t k = grand == fin_toujours || (candidat != dernier && *candidat < *grand) ? *candidat++ : *grand++;
+			Vec3 correction;
+			if(corrigerCollision(objets.get(k), getPos(i), correction)){
+				offsetPos(i, correction);
+			}
+		}
+	}
+}
+
+void Tissu::collisions(const Collisionneurs &objets){
+	if(objets.getNbObjets() == 0) return;
+	PROFIL_SCOPE(PROFIL_COLLISIONS);
+	triangles_a_jour = false;
+	pourTout(getNbParticules(), GRAIN_PARTICULES, [this, &objets](int debut, int fin){
+		collisionsMorceau(objets, debut, fin);
+	});
+}
+
+// ========== SAUVEGARDE ==========
+
+#define ETAT_VERSION 1
+
+static const char MAGIQUE_ETAT[8] = { 'T','I','S','S','U','E','T','A' };
+
+struct EnteteEtat {
+	char magique[8]; // "TISSUETA"
+	uint32_t version;
+	uint32_t taille_params; // sizeof(SimParams), copie telle quelle
+	uint32_t large, hauteur; // particules dans la largeur et la hauteur
+	uint32_t nb_liens, nb_objets;
+	int32_t debut_couleurs[NB_COULEURS+1];
+	float distance_voisins;
+	int32_t iterations;
+	float residu_max, residu_rms;
+	uint64_t taille; // du fichier, pour reconnaitre un fichier tronque
+	SimParams params;
+};
+
+struct ObjetSauve {
+	int32_t type; // TypeCollisionneur
+	float centre[3];
+	float taille;
+	int32_t actif;
+};
+
+/* les tableaux du fichier, chacun aligne sur 64 octets apres l'entete */
+enum { SECTION_POS_X, SECTION_POS_Y, SECTION_POS_Z, SECTION_OLD_X, SECTION_OLD_Y, SECTION_OLD_Z,
+	SECTION_ACC_X, SECTION_ACC_Y, SECTION_ACC_Z, SECTION_INV_MASS, SECTION_LIENS, SECTION_OBJETS, NB_SECTIONS };
+
+/* debut[s] : position de la section s ; debut[NB_SECTIONS] : taille du fichier */
+static void disposerSections(uint64_t n, uint64_t nb_liens, uint64_t nb_objets, uint64_t debut[NB_SECTIONS+1]){
+	uint64_t position = sizeof(EnteteEtat);
+	for(int s=0; s<NB_SECTIONS; s++){
+		position = (position + 63) & ~(uint64_t) 63;
+		debut[s] = position;
+		if(s <= SECTION_INV_MASS) position += n*sizeof(float);
+		else if(s == SECTION_LIENS) position += nb_liens*sizeof(Lien);
+		else position += nb_objets*sizeof(ObjetSauve);
+	}
+	debut[NB_SECTIONS] = position;
+}
+
+/* les liens d'un fichier avant de les accepter : indices dans le tissu (p1 < p2 < n),
+ longueur au repos finie et positive, et chaque couleur triee comme a la construction */
+static bool liensValides(const Lien *liens, const int32_t debut_couleurs[NB_COULEURS+1], uint64_t n){
+	for(int c=0; c<NB_COULEURS; c++){
+		for(int32_t k=debut_couleurs[c]; k<debut_couleurs[c+1]; k++){
+			const Lien &lien = liens[k];
+			if(lien.p1 >= lien.p2 || lien.p2 >= n) return false;
+			if(!std::isfinite(lien.rest_distance) || lien.rest_distance <= 0) return false;
+			if(k > debut_couleurs[c] && avantDansLaMemoire(lien, liens[k-1])) return false;
+		}
+	}
+	return true;
+}
+
+/* les parametres d'un fichier avant de les accepter : un mode connu, au moins un sous-pas,
+ pas d'iterations negatives, amortissement et pas de temps finis */
+static bool paramsValides(const SimParams &p){
+	return (p.mode == GAUSS_SEIDEL || p.mode == JACOBI || p.mode == XPBD) && p.sous_pas >= 1 && p.iterations >= 0
+		&& std::isfinite(p.damping) && std::isfinite(p.time_stepsize2);
+}
+
+/* complete de zeros jusqu'a debut puis ecrit le tableau */
+static bool ecrireSection(FILE *fichier, uint64_t &position, uint64_t debut, const void *donnees, size_t nb_octets){
+	static const char zeros[64] = { 0 };
+	if(debut > position && fwrite(zeros, debut - position, 1, fichier) != 1) return false;
+	position = debut + nb_octets;
+	return nb_octets == 0 || fwrite(donnees, nb_octets, 1, fichier) == 1;
+}
+
+bool Tissu::sauvegarder(const char *chemin, const Collisionneurs *objets) const {
+	size_t n = getNbParticules();
+	std::vector<ObjetSauve> sauves(objets ? objets->getNbObjets() : 0);
+	for(size_t k=0; k<sauves.size(); k++){
+		const Collisionneur &objet = objets->get((int) k);
+		sauves[k].type = objet.type;
+		for(int c=0; c<3; c++) sauves[k].centre[c] = objet.centre.f[c];
+		sauves[k].taille = objet.taille;
+		sauves[k].actif = objet.actif;
+	}
+
+	EnteteEtat entete;
+	memset((void*) &entete, 0, sizeof(entete)); // octets de bourrage compris
+	memcpy(entete.magique, MAGIQUE_ETAT, sizeof(MAGIQUE_ETAT));
+	entete.version = ETAT_VERSION;
+	entete.taille_params = sizeof(SimParams);
+	entete.large = nb_particules_large;
+	entete.hauteur = nb_particules_hauteur;
+	entete.nb_liens = getNbLiens();
+	entete.nb_objets = sauves.size();
+	for(int c=0; c<=NB_COULEURS; c++) entete.debut_couleurs[c] = debut_couleurs[c];
+	entete.distance_voisins = distance_voisins;
+	entete.iterations = iterations;
+	entete.residu_max = residu_max;
+	entete.residu_rms = residu_rms;
+	entete.params = params;
+	uint64_t debut[NB_SECTIONS+1];
+	disposerSections(n, entete.nb_liens, entete.nb_objets, debut);
+	entete.taille = debut[NB_SECTIONS];
+
+	std::string provisoire = std::string(chemin) + ".tmp";
+	FILE *fichier = fopen(provisoire.c_str(), "wb");
+	if(!fichier){
+		perror(provisoire.c_str());
+		return false;
+	}
+	const float *tableaux[SECTION_INV_MASS+1] = { pos_x.data(), pos_y.data(), pos_z.data(), old_x.data(), old_y.data(), old_z.data(),
+		acc_x.data(), acc_y.data(), acc_z.data(), inv_mass.data() };
+	uint64_t position = sizeof(entete);
+	bool ok = fwrite(&entete, sizeof(entete), 1, fichier) == 1;
+	for(int s=0; s<=SECTION_INV_MASS && ok; s++) ok = ecrireSection(fichier, position, debut[s], tableaux[s], n*sizeof(float));
+	if(ok) ok = ecrireSection(fichier, position, debut[SECTION_LIENS], liens.data(), liens.size()*sizeof(Lien));
+	if(ok) ok = ecrireSection(fichier, position, debut[SECTION_OBJETS], sauves.data(), sauves.size()*sizeof(ObjetSauve));
+	if(fclose(fichier) != 0) ok = false;
+	if(ok && rename(provisoire.c_str(), chemin) != 0){
+		perror(chemin);
+		ok = false;
+	}
+	if(!ok) remove(provisoire.c_str());
+	return ok;
+}
+
+bool Tissu::charger(const char *chemin, Collisionneurs *objets){
+	int fichier = open(chemin, O_RDONLY);
+	if(fichier < 0){
+		perror(chemin);
+		return false;
+	}
+	struct stat infos;
+	void *m = MAP_FAILED;
+	if(fstat(fichier, &infos) == 0 && infos.st_size >= (off_t) sizeof(EnteteEtat)){
+		int options = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+		options |= MAP_POPULATE; // toutes les pages d'un coup plutot qu'une faute par page a la copie
+#endif
+		m = mmap(0, infos.st_size, PROT_READ, options, fichier, 0);
+	}
+	close(fichier);
+	if(m == MAP_FAILED){
+		fprintf(stderr, "%s : fichier illisible\n", chemin);
+		return false;
+	}
+	const uint8_t *donnees = (const uint8_t*) m;
+	const EnteteEtat &entete = *(const EnteteEtat*) donnees;
+	uint64_t n = (uint64_t) entete.large*entete.hauteur;
+	uint64_t debut[NB_SECTIONS+1];
+	disposerSections(n, entete.nb_liens, entete.nb_objets, debut);
+	bool ok = !memcmp(entete.magique, MAGIQUE_ETAT, sizeof(MAGIQUE_ETAT)) && entete.version == ETAT_VERSION
+		&& entete.taille_params == sizeof(SimParams) && entete.taille == (uint64_t) infos.st_size && debut[NB_SECTIONS] == entete.taille
+		&& n <= 0x7fffffff && entete.debut_couleurs[0] == 0 && entete.debut_couleurs[NB_COULEURS] == (int32_t) entete.nb_liens;
+	for(int c=0; c<NB_COULEURS && ok; c++) ok = entete.debut_couleurs[c] <= entete.debut_couleurs[c+1];
+	if(ok) ok = liensValides((const Lien*)(donnees + debut[SECTION_LIENS]), entete.debut_couleurs, n);
+	if(ok) ok = paramsValides(entete.params);
+	if(!ok){
+		fprintf(stderr, "%s : pas un etat de tissu (ou d'une autre version)\n", chemin);
+		munmap(m, infos.st_size);
+		return false;
+	}
+
+	nb_particules_large = entete.large;
+	nb_particules_hauteur = entete.hauteur;
+	params = entete.params;
+	for(int c=0; c<=NB_COULEURS; c++) debut_couleurs[c] = entete.debut_couleurs[c];
+	distance_voisins = entete.distance_voisins;
+	iterations = entete.iterations;
+	residu_max = entete.residu_max;
+	residu_rms = entete.residu_rms;
+
+	TableauFloat *tableaux[SECTION_INV_MASS+1] = { &pos_x, &pos_y, &pos_z, &old_x, &old_y, &old_z, &acc_x, &acc_y, &acc_z, &inv_mass };
+	for(int s=0; s<=SECTION_INV_MASS; s++){
+		const float *source = (const float*)(donnees + debut[s]);
+		tableaux[s]->assign(source, source + n);
+	}
+	const Lien *source_liens = (const Lien*)(donnees + debut[SECTION_LIENS]);
+	liens.assign(source_liens, source_liens + entete.nb_liens);
+	normal_x.assign(n, 0); normal_y.assign(n, 0); normal_z.assign(n, 0);
+
+	// refaits a la demande : listes de Jacobi, voisins des auto-collisions, multiplicateurs XPBD, triangles
+	debut_incidents.clear();
+	incidents.clear();
+	debut_voisins.clear();
+	voisins.clear();
+	lambda.clear();
+	triangles_a_jour = false;
+
+	if(objets){
+		const ObjetSauve *sauves = (const ObjetSauve*)(donnees + debut[SECTION_OBJETS]);
+		objets->vider();
+		for(uint32_t k=0; k<entete.nb_objets; k++){
+			Vec3 centre(sauves[k].centre[0], sauves[k].centre[1], sauves[k].centre[2]);
+			int i = sauves[k].type == COLLISION_CUBE ? objets->ajouterCube(centre, sauves[k].taille) : objets->ajouterSphere(centre, sauves[k].taille);
+			objets->get(i).actif = sauves[k].actif != 0;
+		}
+		objets->miseAJour();
+	}
+	munmap(m, infos.st_size);
+	return true;
+}
@@ -0,0 +1,326 @@
+#ifndef TISSU_H
+#define TISSU_H
+
+#include <vector>
+#include <stdint.h>
+#include "vec3.h"
+#include "aligne.h"
+#include "collision.h"
+
+struct FluxIntegration;
+class PoolThreads;
+class ObservateurPhases;
+
+/* Coeur de la simulation du tissu (particules + liens), sans OpenGL :
+ utilise par scene.cc, plan.cc et par le banc d'essai bench.cc */
+
+/* les liens sont repartis en couleurs : deux liens de meme couleur ne touchent jamais
+ la meme particule, on peut donc resoudre une couleur en parallele.
+ 8 familles (horizontale, verticale, deux diagonales, et les memes a distance 2) x 2 couleurs */
+#define NB_COULEURS 16
+
+/* GAUSS_SEIDEL : chaque lien deplace ses particules tout de suite (par couleur)
+ JACOBI : tous les liens sont evalues sur les positions de l'iteration precedente,
+ puis chaque particule recoit la moyenne des corrections de ses liens ; le resultat
+ est le meme quel que soit le nombre de threads
+ XPBD : Gauss-Seidel par couleur avec une souplesse (compliance) par famille de liens et
+ un multiplicateur de Lagrange par lien ; la raideur ne depend plus du nombre de passes
+ ni du pas de temps, et le pas est decoupe en sous_pas petits pas */
+enum ModeSolveur { GAUSS_SEIDEL, JACOBI, XPBD };
+
+// ========== PARAMETRES DE SIMULATION ==========
+/* Parametres lus a chaque pas : on peut les changer sans recompiler (setParams). */
+struct SimParams {
+	float damping; // amortissement de la vitesse a chaque pas
+	float time_stepsize2; // carre du pas de temps
+	int iterations; // nombre maximum de passes sur les liens par pas
+	ModeSolveur mode;
+	float relaxation; // en JACOBI, chaque particule bouge de relaxation * (moyenne des corrections de ses liens)
+	// arret anticipe des passes quand l'erreur relative des liens (|distance - rest_distance|/rest_distance)
+	// passe sous ces tolerances (0 : ignoree ; les deux a 0 : toujours 'iterations' passes)
+	float tolerance_max, tolerance_rms;
+	// auto-collisions : distance minimum entre deux particules non liees, en fraction de la
+	// distance entre particules voisines (0 : le tissu peut se traverser, au plus 1)
+	float epaisseur;
+	// doFrame : gravite, integration et collisions avec les objets faites bloc par bloc
+	// pendant que les particules sont dans le cache (false : une passe par etape)
+	bool fusion;
+	// XPBD : nombre de sous-pas par pas (chacun fait 'iterations' passes puis integre), et
+	// souplesse (inverse de la raideur, 0 : inextensible) des liens a distance 1 (horizontaux
+	// et verticaux), des diagonales, et des liens a distance 2 (flexion)
+	int sous_pas;
+	float compliance_etirement, compliance_cisaillement, compliance_flexion;
+
+	SimParams() : damping(0.01f), time_stepsize2(0.5f*0.5f), iterations(15), mode(GAUSS_SEIDEL), relaxation(1), tolerance_max(0), tolerance_rms(0), epaisseur(0), fusion(true),
+		sous_pas(1), compliance_etirement(0), compliance_cisaillement(0), compliance_flexion(0) {}
+};
+
+/* particules immobiles a la creation du tissu (rangee du haut, y = 0) :
+ DRAPEAU : la partie droite de la rangee a partir de 1/2.5 de la largeur, decalee de 0.5 en x
+ GAUCHE : la meme chose a gauche (decalee de -0.5), HAUT : toute la rangee, COINS : les deux coins */
+enum Epinglage { EPINGLAGE_DRAPEAU, EPINGLAGE_GAUCHE, EPINGLAGE_HAUT, EPINGLAGE_COINS };
+
+// ========== CLASSE LIEN ===========
+/* 12 octets par lien : les indices restent valides si les tableaux de particules
+ sont realloues, et un Tissu peut etre copie tel quel */
+struct Lien {
+	uint32_t p1, p2; // indices des deux particules reliees par une meme contrainte (p1 < p2)
+	float rest_distance; // distance entre deux particules
+};
+
+// ========== DEFINITION DE LA CLASSE TISSU==========
+/* Les particules sont rangees en structure de tableaux : chaque composante (x, y, z)
+ de chaque grandeur est un tableau aligne separe, pour que chaque passe ne lise que
+ ce dont elle a besoin. La particule (x,y) est a l'indice y*nb_particules_large + x. */
+class Tissu {
+private:
+	TableauFloat pos_x, pos_y, pos_z; // position des particules
+	TableauFloat old_x, old_y, old_z; // position des particules au temps t-1
+	TableauFloat acc_x, acc_y, acc_z; // acceleration des particules
+	TableauFloat normal_x, normal_y, normal_z; // normales accumulees (pour l'affichage)
+	TableauFloat inv_mass; // inverse de la masse, 0 pour une particule immobile
+
+	std::vector<Lien> liens; // tous les liens reliant les particules du tissu entre elles, ranges par couleur
+	int debut_couleurs[NB_COULEURS+1]; // les liens de la couleur c sont dans [debut_couleurs[c], debut_couleurs[c+1])
+
+	
+	int nb_particules_large; // nombre de particules dans la largeur
+	int nb_particules_hauteur; // nombre de particules dans la hauteur
+	// nb total de particules =  nb_particules_large*nb_particules_hauteur
+
+	PoolThreads *pool; // threads pour les boucles paralleles (0 : tout dans le thread appelant)
+	ObservateurPhases *observateur; // prevenu des passes sur les liens et de l'integration (0 : aucun)
+
+	SimParams params;
+
+	// mode JACOBI : une correction par lien, et pour chaque particule la liste de ses liens
+	TableauFloat corr_x, corr_y, corr_z;
+	std::vector<uint32_t> debut_incidents; // les liens de la particule i sont dans [debut_incidents[i], debut_incidents[i+1])
+	std::vector<uint32_t> incidents; // 2*lien + 1 si la particule est le p2 du lien
+	TableauFloat poids_incidents; // relaxation/nb de liens de la particule (0 si immobile)
+
+	// mode XPBD : multiplicateur de Lagrange de chaque lien, remis a 0 a chaque sous-pas
+	TableauFloat lambda;
+
+	// auto-collisions : grille hachee des particules, refaite a chaque appel (tri par comptage)
+	float distance_voisins; // plus petite distance au repos entre deux particules voisines
+	std::vector<uint32_t> debut_voisins; // les particules liees a i sont voisins[debut_voisins[i] .. debut_voisins[i+1]), croissantes
+	std::vector<uint32_t> voisins;
+	std::vector<uint32_t> alveoles_particules; // alveole de chaque particule
+	std::vector<uint32_t> debut_alveoles; // les particules de l'alveole h sont dans [debut_alveoles[h], debut_alveoles[h+1])
+	std::vector<uint32_t> particules_triees;
+	std::vector<uint32_t> curseurs_alveoles; // prochaine place de chaque alveole pendant le rangement
+	TableauFloat repousse_x, repousse_y, repousse_z; // deplacement calcule pour chaque particule
+
+	// normales des deux triangles de chaque case (voir FluxTriangles), calculees une fois
+	// pour le vent et les normales d'affichage, tant que les positions ne changent pas
+	TableauFloat triangle_x[2], triangle_y[2], triangle_z[2]; // produit vectoriel (double de l'aire)
+	TableauFloat unitaire_x[2], unitaire_y[2], unitaire_z[2]; // normale unitaire
+	bool triangles_a_jour;
+
+	int iterations; // passes faites au dernier timeStep
+	float residu_max, residu_rms; // erreur max et moyenne quadratique mesurees a la derniere passe
+	
+	Lien creerLien(int p1, int p2);
+
+	/* appelle f(debut, fin) sur des morceaux de [0, n), en parallele si le tissu a un pool */
+	template<class F> void pourTout(int n, int grain, const F &f);
+
+	/* pointeurs vers les tableaux lus et ecrits par l'integration */
+	FluxIntegration flux();
+
+	/* deplace une particule si elle n'est pas immobile */
+	void offsetPos(int i, const Vec3 v) {
+		pos_x[i] += v.f[0]*inv_mass[i];
+		pos_y[i] += v.f[1]*inv_mass[i];
+		pos_z[i] += v.f[2]*inv_mass[i];
+	}
+
+	/* lien entre deux particules, retourne la distance avant correction	*/
+	float lienPossible(const Lien &lien);
+
+	/* meme chose en XPBD : souplesse alpha_tilde = compliance/dt2 du sous-pas, *lambda cumule */
+	float lienXpbd(const Lien &lien, float *lambda, float alpha_tilde);
+
+	/* souplesse des liens de la couleur c (voir le constructeur pour l'ordre des familles) */
+	float complianceCouleur(int c) const;
+
+	/* une passe sur tous les liens ; si mesurer, on calcule aussi l'erreur des liens
+	 avant la passe (residu_max, residu_rms) */
+	void iterationGaussSeidel(bool mesurer);
+	void iterationJacobi(bool mesurer);
+	void iterationXpbd(bool mesurer, float dt2);
+	void mesurerCorrections();
+	void preparerJacobi();
+	void calculerPoidsJacobi();
+
+	/* ce que l'integration de doFrame fait en plus : avec params.fusion, sur chaque bloc de
+	 particules ; sans, les objets en une passe apres l'integration (et pas de gravite) */
+	struct Fusion {
+		Vec3 gravite;
+		const Collisionneurs *objets;
+	};
+
+	/* integration de verlet de toutes les particules ; avec une fusion, chaque bloc
+	 recoit la gravite, est integre puis sorti des objets avant de passer au suivant
+	 (sans params.fusion : integration puis collisions, chacune sa passe) */
+	void integrer(float amortissement, float dt2, const Fusion *fusion, bool garder_acceleration = false);
+
+	/* collisions des particules [debut, fin) avec les objets */
+	void collisionsMorceau(const Collisionneurs &objets, int debut, int fin);
+
+	/* pas de temps (passes sur les liens puis integration) ; pas() choisit la version du solveur */
+	void pas(const Fusion *fusion);
+	void timeStepGenerique(const Fusion *fusion);
+	void timeStepXpbd(const Fusion *fusion);
+
+	/* remplit triangle_* si les positions ont change depuis le dernier appel */
+	void calculerTriangles();
+
+	/* normale (non normalisee) du triangle t de la case c, et la meme normalisee */
+	Vec3 triangleNormal(int t, int c) const {
+		return Vec3(triangle_x[t][c], triangle_y[t][c], triangle_z[t][c]);
+	}
+	Vec3 triangleUnitaire(int t, int c) const {
+		return Vec3(unitaire_x[t][c], unitaire_y[t][c], unitaire_z[t][c]);
+	}
+
+	/* appelle f(t, c) pour chaque triangle t de la case c qui touche la particule (x,y) : au plus 6,
+	 dans l'ordre des cases (ligne par ligne). Chaque particule rassemble ainsi ce que ses
+	 triangles lui donnent, sans ecrire chez ses voisines : les lignes peuvent etre en parallele. */
+	template<class F> void pourTrianglesAutour(int x, int y, const F &f) const;
+
+	/* force du vent sur chacun des sommets du triangle t de la case c */
+	Vec3 forceVent(int t, int c, const Vec3 direction) const {
+		return triangleNormal(t, c)*(triangleUnitaire(t, c).dot(direction));
+	}
+
+	/* vrai si les particules i et j sont reliees par un lien (d'apres liens, quelle que soit
+	 la topologie : construite ou chargee) */
+	void preparerVoisins();
+	bool lies(int i, int j) const;
+	void construireGrilleParticules(float taille_cellule);
+	void construireGrilleParallele(float taille_cellule, uint32_t nb_alveoles);
+
+public:
+
+	/* Constructeur pour le tissu (particules + liens)*/
+	Tissu(float large, float hauteur, int nb_particules_large, int nb_particules_hauteur, const SimParams &params = SimParams(), Epinglage epinglage = EPINGLAGE_DRAPEAU);
+
+	/* tissu vide (aucune particule), a remplir avec charger() */
+	Tissu();
+
+	/* grille seule : positions et normales, sans liens, masses ni vitesses. Sert a calculer
+	 les normales de positions venues d'ailleurs (relecture) : seuls placerPositions,
+	 calculerNormales et les copies y ont un sens, pas les pas de simulation. */
+	Tissu(int nb_particules_large, int nb_particules_hauteur);
+
+	/* les boucles paralleles utiliseront ce pool (0 pour revenir a un seul thread) */
+	void setPool(PoolThreads *pool) { this->pool = pool; }
+
+	/* l'observateur est prevenu du debut et de la fin des passes sur les liens et de
+	 chaque integration (a chaque sous-pas en XPBD) ; 0 pour n'en plus avoir */
+	void setObservateur(ObservateurPhases *observateur) { this->observateur = observateur; }
+
+	void setParams(const SimParams &params);
+	const SimParams &getParams() const { return params; }
+
+	/* passes faites au dernier timeStep (en XPBD, sur tous les sous-pas), et erreur
+	 relative des liens (max et moyenne quadratique) mesuree a la derniere passe : a
+	 chaque passe si une tolerance est donnee, sinon seulement a la derniere */
+	int getIterations() const { return iterations; }
+	float getResiduMax() const { return residu_max; }
+	float getResiduRms() const { return residu_rms; }
+
+	int index(int x, int y) const {
+		return y*nb_particules_large + x;
+	}
+
+	Vec3 getPos(int i) const {
+		return Vec3(pos_x[i], pos_y[i], pos_z[i]);
+	}
+
+	Vec3 getNormal(int i) const {
+		return Vec3(normal_x[i], normal_y[i], normal_z[i]);
+	}
+
+	bool isMovable(int i) const {
+		return inv_mass[i] != 0;
+	}
+
+	/* deplacement par unite de temps au dernier pas (ou sous-pas XPBD) */
+	Vec3 getVitesse(int i) const;
+
+	/* plus grand allongement relatif des liens, (distance - rest_distance)/rest_distance */
+	float etirementMax() const;
+
+	int getNbParticulesLarge() const { return nb_particules_large; }
+	int getNbParticulesHauteur() const { return nb_particules_hauteur; }
+	int getNbParticules() const { return (int) pos_x.size(); }
+	int getNbLiens() const { return (int) liens.size(); }
+	size_t getMemoireLiens() const { return liens.capacity()*sizeof(Lien); } // en octets
+
+	/* reinitialise puis accumule les normales de chaque particule (utilise pour l'affichage)*/
+	void calculerNormales();
+
+	/* pour l'affichage : 6 floats par particule dans sommets, la position puis la normale
+	 normalisee (apres calculerNormales) */
+	void copierSommets(float *sommets);
+
+	/* les positions en trois plans : les x des particules, puis les y, puis les z
+	 (3*getNbParticules() floats) */
+	void copierPositions(float *positions) const;
+
+	/* l'inverse : place les particules aux positions donnees, sans vitesse */
+	void placerPositions(const float *positions);
+
+	/* deplace tout le tissu (positions et positions precedentes : la vitesse ne change pas) */
+	void translater(const Vec3 v);
+
+	/*  on regarde comment vont reagir les liens et les particules au temps t+1*/
+	void timeStep();
+
+	/* ajout de la gravite a toutes les particules*/
+	void addForce(const Vec3 direction);
+
+	/* ajout des forces de vent a toutes les particules*/
+	void windForce(const Vec3 direction);
+
+	/* dectection et resolution de la collision tissu/ball
+	 On compare la position de la sphere et de chaque particule et on les corrige
+	 */
+	void ballCollision(const Vec3 center,const float radius );
+
+	/*detection et resolution d'une collision tissu/cube.*/
+	void cubeCollision(const Vec3 center,const float cube_size,const Vec3 cube_pos);
+
+	/* collision avec tous les objets actifs du registre (grille a jour : objets.miseAJour()) */
+	void collisions(const Collisionneurs &objets);
+
+	/* le tissu ne se traverse plus : deux particules qui ne sont pas reliees par un lien sont
+	 ecartees jusqu'a params.epaisseur (rien si 0). Chaque particule recoit la moyenne des
+	 deplacements de ses contacts, calcules sur les memes positions (independant des threads). */
+	void autoCollisions();
+
+	/* une image complete : gravite, vent, timeStep, collisions avec les objets apres
+	 chaque integration (apres chaque sous-pas en XPBD) puis auto-collisions. Les forces
+	 sont deja multipliees par le pas de temps, comme pour addForce et windForce. Avec
+	 params.fusion, la gravite, l'integration et les objets ne font qu'une passe sur les
+	 particules ; le resultat ne differe que par l'ordre des additions de la gravite et
+	 du vent. */
+	void doFrame(const Vec3 gravite, const Vec3 vent, const Collisionneurs &objets);
+
+	/* Etat complet du tissu dans un fichier binaire versionne : SimParams, positions,
+	 positions precedentes, accelerations, masses (particules immobiles), liens et
+	 couleurs, et les objets s'ils sont donnes. Les tableaux sont alignes sur 64 octets :
+	 charger() projette le fichier en memoire et copie chaque tableau d'un bloc, sans
+	 reconstruire ni trier les liens. On ecrit dans chemin.tmp puis on renomme : une
+	 sauvegarde interrompue ne remplace pas la precedente. */
+	bool sauvegarder(const char *chemin, const Collisionneurs *objets = 0) const;
+
+	/* remplace tout l'etat du tissu (la taille peut changer) et, si objets n'est pas nul,
+	 les objets ; false (et rien ne change) si le fichier est illisible ou d'une autre version */
+	bool charger(const char *chemin, Collisionneurs *objets = 0);
+};
+
+#endif
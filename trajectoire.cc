@@ -0,0 +1,453 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trajectoire.h"
+
+// ========== CODAGE ==========
+
+#define TAILLE_FENETRE (16 << 20) // octets du fichier projetes a la fois a l'ecriture (multiple de la page)
+#define Q_MAX (1 << 29) // borne des coordonnees entieres
+
+static const char MAGIQUE[8] = { 'T','I','S','S','U','T','R','J' };
+
+/* ecart en complement a deux (calcule modulo 2^32) -> non signe, les petits ecarts
+ (positifs ou negatifs) restent petits */
+static uint32_t zigzag(uint32_t v){
+	return (v << 1) ^ (0u - (v >> 31));
+}
+
+static uint32_t dezigzag(uint32_t u){
+	return (u >> 1) ^ (0u - (u & 1));
+}
+
+/* prediction de la coordonnee entiere : meme vitesse qu'a l'image precedente (rang >= 2)
+ ou meme position. Tout est calcule modulo 2^32 : un saut de particule (remise a zero,
+ grand pas) ne peut pas deborder, et le lecteur retrouve exactement q en ajoutant l'ecart. */
+static uint32_t predire(int rang, int32_t q1, int32_t q2){
+	return rang >= 2 ? 2*(uint32_t) q1 - (uint32_t) q2 : (uint32_t) q1;
+}
+
+static void ecrireVarint(std::vector<uint8_t> &sortie, uint64_t v){
+	while(v >= 0x80){
+		sortie.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+	sortie.push_back((uint8_t) v);
+}
+
+static bool lireVarint(const uint8_t *&p, const uint8_t *fin, uint64_t &v){
+	v = 0;
+	for(int decalage=0; decalage<64; decalage+=7){
+		if(p == fin) return false;
+		uint8_t octet = *p++;
+		v |= (uint64_t)(octet & 0x7f) << decalage;
+		if(!(octet & 0x80)) return true;
+	}
+	return false;
+}
+
+/* un code par valeur non nulle (valeur << 1), un code pour une suite de zeros (longueur << 1 | 1) */
+static void coderValeurs(const uint32_t *valeurs, size_t n, std::vector<uint8_t> &sortie){
+	size_t i = 0;
+	while(i < n){
+		if(valeurs[i] != 0){
+			ecrireVarint(sortie, (uint64_t) valeurs[i] << 1);
+			i++;
+			continue;
+		}
+		size_t debut = i;
+		while(i < n && valeurs[i] == 0) i++;
+		ecrireVarint(sortie, ((uint64_t)(i - debut) << 1) | 1);
+	}
+}
+
+static bool decoderValeurs(const uint8_t *&p, const uint8_t *fin, uint32_t *valeurs, size_t n){
+	size_t i = 0;
+	while(i < n){
+		uint64_t code;
+		if(!lireVarint(p, fin, code)) return false;
+		if(code & 1){
+			uint64_t zeros = code >> 1;
+			if(zeros > n - i) return false;
+			memset(valeurs + i, 0, zeros*sizeof(uint32_t));
+			i += zeros;
+		}
+		else {
+			if((code >> 1) > 0xffffffffu) return false;
+			valeurs[i++] = (uint32_t)(code >> 1);
+		}
+	}
+	return true;
+}
+
+static void ajouterOctets(std::vector<uint8_t> &sortie, const void *donnees, size_t nb_octets){
+	size_t debut = sortie.size();
+	sortie.resize(debut + nb_octets);
+	memcpy(&sortie[debut], donnees, nb_octets);
+}
+
+static int32_t quantifier(float x, float origine, float pas){
+	float q = floorf((x - origine)/pas + 0.5f);
+	return (int32_t) std::max(-(float) Q_MAX, std::min((float) Q_MAX, q));
+}
+
+/* grille de la premiere image d'un bloc : la boite englobante, 65535 pas dans sa plus
+ grande dimension (le meme pas sur les trois axes) */
+static void choisirGrille(const float *positions, size_t nb_particules, EtatTrajectoire &etat){
+	float etendue = 0;
+	for(int c=0; c<3; c++){
+		const float *plan = positions + c*nb_particules;
+		float min = plan[0], max = plan[0];
+		for(size_t i=1; i<nb_particules; i++){
+			min = std::min(min, plan[i]);
+			max = std::max(max, plan[i]);
+		}
+		etat.origine[c] = min;
+		etendue = std::max(etendue, max - min);
+	}
+	etat.pas = etendue > 0 ? etendue/65535 : 1;
+}
+
+// ========== ENREGISTREUR ==========
+
+Enregistreur::Enregistreur() : fichier(-1), erreur(false), fenetre(0), debut_fenetre(0), taille(0), arret(false), attendre(false), nb_images(0), nb_perdues(0) {}
+
+Enregistreur::~Enregistreur(){
+	fermer();
+}
+
+bool Enregistreur::ouvrir(const char *chemin, const Tissu &tissu, int options, int images_par_bloc, int nb_tampons, bool attendre){
+	fermer();
+	fichier = open(chemin, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fichier < 0){
+		perror(chemin);
+		return false;
+	}
+	memset(&entete, 0, sizeof(entete));
+	memcpy(entete.magique, MAGIQUE, sizeof(MAGIQUE));
+	entete.version = TRAJECTOIRE_VERSION;
+	entete.options = options;
+	entete.nb_particules = tissu.getNbParticules();
+	entete.large = tissu.getNbParticulesLarge();
+	entete.hauteur = tissu.getNbParticulesHauteur();
+	entete.images_par_bloc = std::max(1, images_par_bloc);
+
+	size_t n = 3*(size_t) entete.nb_particules;
+	etat.q1.assign(n, 0);
+	etat.q2.assign(n, 0);
+	etat.bits.assign(n, 0);
+	etat.valeurs.assign(n, 0);
+	nb_tampons = std::max(1, nb_tampons);
+	tampons.assign(nb_tampons, std::vector<float>(n));
+	libres.clear();
+	pleins.clear();
+	for(int t=0; t<nb_tampons; t++) libres.push_back(t);
+	this->attendre = attendre;
+	index.clear();
+	erreur = false;
+	taille = 0;
+	nb_images = 0;
+	nb_perdues = 0;
+
+	ecrire(&entete, sizeof(entete)); // entete provisoire, sans index
+	arret = false;
+	thread = std::thread(&Enregistreur::boucle, this);
+	return !erreur;
+}
+
+bool Enregistreur::ajouterImage(const Tissu &tissu){
+	if(fichier < 0 || erreur || tissu.getNbParticules() != (int) entete.nb_particules) return false;
+	nb_images++;
+	int t;
+	{
+		std::unique_lock<std::mutex> verrouille(verrou);
+		if(attendre){
+			while(libres.empty()) changement.wait(verrouille);
+		}
+		else if(libres.empty()){
+			nb_perdues++;
+			return false;
+		}
+		t = libres.front();
+		libres.pop_front();
+	}
+	tissu.copierPositions(&tampons[t][0]);
+	{
+		std::lock_guard<std::mutex> garde(verrou);
+		pleins.push_back(t);
+	}
+	changement.notify_all();
+	return true;
+}
+
+void Enregistreur::boucle(){
+	for(;;){
+		int t;
+		{
+			std::unique_lock<std::mutex> verrouille(verrou);
+			while(pleins.empty() && !arret) changement.wait(verrouille);
+			if(pleins.empty()) return; // arret, tout est ecrit
+			t = pleins.front();
+			pleins.pop_front();
+		}
+		if(!erreur){
+			coder(&tampons[t][0], (long) index.size());
+			EntreeIndex entree = { taille, code.size() };
+			ecrire(&code[0], code.size());
+			index.push_back(entree);
+		}
+		{
+			std::lock_guard<std::mutex> garde(verrou);
+			libres.push_back(t);
+		}
+		changement.notify_all();
+	}
+}
+
+void Enregistreur::coder(const float *positions, long numero){
+	size_t nb_particules = entete.nb_particules, n = 3*nb_particules;
+	int rang = numero % entete.images_par_bloc; // place dans le bloc
+	bool deltas = (entete.options & TRAJECTOIRE_DELTAS) && rang > 0;
+	code.clear();
+
+	if(entete.options & TRAJECTOIRE_QUANTIFIEE){
+		if(!deltas) choisirGrille(positions, nb_particules, etat);
+		ajouterOctets(code, etat.origine, 3*sizeof(float));
+		ajouterOctets(code, &etat.pas, sizeof(float));
+		if(!deltas){
+			size_t debut = code.size();
+			code.resize(debut + n*sizeof(uint16_t));
+			for(size_t i=0; i<n; i++){
+				int32_t q = std::max(0, std::min(65535, quantifier(positions[i], etat.origine[i/nb_particules], etat.pas)));
+				uint16_t q16 = (uint16_t) q;
+				memcpy(&code[debut + i*sizeof(uint16_t)], &q16, sizeof(q16));
+				etat.q1[i] = etat.q2[i] = q;
+			}
+			return;
+		}
+		for(size_t i=0; i<n; i++){
+			int32_t q = quantifier(positions[i], etat.origine[i/nb_particules], etat.pas);
+			etat.valeurs[i] = zigzag((uint32_t) q - predire(rang, etat.q1[i], etat.q2[i]));
+			etat.q2[i] = etat.q1[i];
+			etat.q1[i] = q;
+		}
+		coderValeurs(&etat.valeurs[0], n, code);
+		return;
+	}
+
+	if(!deltas){
+		ajouterOctets(code, positions, n*sizeof(float));
+		memcpy(&etat.bits[0], positions, n*sizeof(float));
+		return;
+	}
+	for(size_t i=0; i<n; i++){
+		uint32_t bits;
+		memcpy(&bits, positions+i, sizeof(bits));
+		etat.valeurs[i] = bits ^ etat.bits[i];
+		etat.bits[i] = bits;
+	}
+	coderValeurs(&etat.valeurs[0], n, code);
+}
+
+/* projette la portion du fichier qui contient position, en agrandissant le fichier. Les
+ blocs de la fenetre sont reserves sur le disque avant la projection : un disque plein
+ (ou un quota) donne une erreur ici, et non un SIGBUS a la premiere ecriture dans une
+ page d'un fichier creux. */
+bool Enregistreur::deplacerFenetre(uint64_t position){
+	if(fenetre) munmap(fenetre, TAILLE_FENETRE);
+	fenetre = 0;
+	debut_fenetre = position - position % TAILLE_FENETRE;
+	int resultat = posix_fallocate(fichier, debut_fenetre, TAILLE_FENETRE);
+	if(resultat != 0){
+		fprintf(stderr, "trajectoire : %s\n", strerror(resultat));
+		return false;
+	}
+	void *m = mmap(0, TAILLE_FENETRE, PROT_READ | PROT_WRITE, MAP_SHARED, fichier, debut_fenetre);
+	if(m == MAP_FAILED){
+		perror("trajectoire");
+		return false;
+	}
+	fenetre = (uint8_t*) m;
+	return true;
+}
+
+void Enregistreur::ecrire(const void *donnees, size_t nb_octets){
+	const uint8_t *source = (const uint8_t*) donnees;
+	while(nb_octets > 0 && !erreur){
+		if(!fenetre || taille >= debut_fenetre + TAILLE_FENETRE){
+			if(!deplacerFenetre(taille)){
+				erreur = true;
+				return;
+			}
+		}
+		size_t place = debut_fenetre + TAILLE_FENETRE - taille;
+		size_t nb = std::min(place, nb_octets);
+		memcpy(fenetre + (taille - debut_fenetre), source, nb);
+		taille += nb;
+		source += nb;
+		nb_octets -= nb;
+	}
+}
+
+bool Enregistreur::fermer(){
+	if(fichier < 0) return true;
+	{
+		std::lock_guard<std::mutex> garde(verrou);
+		arret = true;
+	}
+	changement.notify_all();
+	thread.join();
+
+	// index aligne sur 8 octets, a la suite des images
+	uint64_t zeros = 0;
+	ecrire(&zeros, (8 - taille % 8) % 8);
+	entete.debut_index = taille;
+	entete.nb_images = index.size();
+	if(!index.empty()) ecrire(&index[0], index.size()*sizeof(EntreeIndex));
+
+	if(fenetre) munmap(fenetre, TAILLE_FENETRE);
+	fenetre = 0;
+	// le fichier est ramene a ce qui est ecrit, meme apres une erreur (sans index : illisible)
+	bool ok = ftruncate(fichier, taille) == 0 && !erreur && pwrite(fichier, &entete, sizeof(entete), 0) == (ssize_t) sizeof(entete);
+	if(close(fichier) != 0) ok = false;
+	fichier = -1;
+	tampons.clear();
+	if(nb_perdues > 0) fprintf(stderr, "trajectoire : %ld images perdues sur %ld (ecriture trop lente)\n", getNbPerdues(), getNbImages());
+	return ok;
+}
+
+// ========== LECTEUR ==========
+
+LecteurTrajectoire::LecteurTrajectoire() : donnees(0), taille(0), entete(0), index(0), courante(-1) {}
+
+LecteurTrajectoire::~LecteurTrajectoire(){
+	fermer();
+}
+
+bool LecteurTrajectoire::ouvrir(const char *chemin){
+	fermer();
+	int fichier = open(chemin, O_RDONLY);
+	if(fichier < 0){
+		perror(chemin);
+		return false;
+	}
+	struct stat infos;
+	void *m = MAP_FAILED;
+	if(fstat(fichier, &infos) == 0 && infos.st_size >= (off_t) sizeof(EnteteTrajectoire)){
+		m = mmap(0, infos.st_size, PROT_READ, MAP_SHARED, fichier, 0);
+	}
+	close(fichier); // la projection reste valable
+	if(m == MAP_FAILED){
+		fprintf(stderr, "%s : fichier illisible\n", chemin);
+		return false;
+	}
+	donnees = (const uint8_t*) m;
+	taille = infos.st_size;
+	entete = (const EnteteTrajectoire*) donnees;
+
+	uint64_t fin_index = entete->debut_index + entete->nb_images*sizeof(EntreeIndex);
+	if(memcmp(entete->magique, MAGIQUE, sizeof(MAGIQUE)) || entete->version != TRAJECTOIRE_VERSION || entete->images_par_bloc == 0
+		|| entete->debut_index == 0 || entete->debut_index % 8 || entete->nb_images > taille || fin_index > taille){
+		fprintf(stderr, "%s : pas une trajectoire (ou pas fermee)\n", chemin);
+		fermer();
+		return false;
+	}
+	index = (const EntreeIndex*)(donnees + entete->debut_index);
+
+	size_t n = 3*(size_t) entete->nb_particules;
+	etat.q1.assign(n, 0);
+	etat.q2.assign(n, 0);
+	etat.bits.assign(n, 0);
+	etat.valeurs.assign(n, 0);
+	courante = -1;
+	return true;
+}
+
+void LecteurTrajectoire::fermer(){
+	if(donnees) munmap((void*) donnees, taille);
+	donnees = 0;
+	taille = 0;
+	entete = 0;
+	index = 0;
+	courante = -1;
+}
+
+bool LecteurTrajectoire::lireImage(long n, float *positions){
+	if(!donnees || n < 0 || n >= getNbImages()) return false;
+	long premiere = n;
+	if(entete->options & TRAJECTOIRE_DELTAS){
+		long debut_bloc = n - n % entete->images_par_bloc;
+		premiere = (courante >= debut_bloc && courante < n) ? courante+1 : debut_bloc;
+	}
+	for(long k=premiere; k<=n; k++){
+		if(!decoder(k, positions)){
+			courante = -1;
+			return false;
+		}
+		courante = k;
+	}
+	return true;
+}
+
+void LecteurTrajectoire::precharger(long premiere, long derniere) const {
+	if(!donnees) return;
+	premiere = std::max(premiere, 0L);
+	derniere = std::min(derniere, getNbImages()-1);
+	if(premiere > derniere) return;
+	uint64_t debut = std::min<uint64_t>(index[premiere].debut, taille);
+	uint64_t fin = std::min<uint64_t>(index[derniere].debut + index[derniere].taille, taille);
+	uint64_t page = sysconf(_SC_PAGESIZE);
+	debut -= debut % page;
+	if(fin > debut) madvise((void*)(donnees + debut), fin - debut, MADV_WILLNEED);
+}
+
+/* meme chemin que Enregistreur::coder, a l'envers */
+bool LecteurTrajectoire::decoder(long numero, float *positions){
+	const EntreeIndex &entree = index[numero];
+	if(entree.debut > taille || entree.taille > taille - entree.debut) return false;
+	const uint8_t *p = donnees + entree.debut, *fin = p + entree.taille;
+	size_t nb_particules = entete->nb_particules, n = 3*nb_particules;
+	int rang = numero % entete->images_par_bloc;
+	bool deltas = (entete->options & TRAJECTOIRE_DELTAS) && rang > 0;
+
+	if(entete->options & TRAJECTOIRE_QUANTIFIEE){
+		if(fin - p < (long)(4*sizeof(float))) return false;
+		memcpy(etat.origine, p, 3*sizeof(float));
+		memcpy(&etat.pas, p + 3*sizeof(float), sizeof(float));
+		p += 4*sizeof(float);
+		if(!deltas){
+			if((size_t)(fin - p) < n*sizeof(uint16_t)) return false;
+			for(size_t i=0; i<n; i++){
+				uint16_t q16;
+				memcpy(&q16, p + i*sizeof(uint16_t), sizeof(q16));
+				etat.q1[i] = etat.q2[i] = q16;
+				positions[i] = etat.origine[i/nb_particules] + q16*etat.pas;
+			}
+			return true;
+		}
+		if(!decoderValeurs(p, fin, &etat.valeurs[0], n)) return false;
+		for(size_t i=0; i<n; i++){
+			int32_t q = (int32_t)(predire(rang, etat.q1[i], etat.q2[i]) + dezigzag(etat.valeurs[i]));
+			etat.q2[i] = etat.q1[i];
+			etat.q1[i] = q;
+			positions[i] = etat.origine[i/nb_particules] + q*etat.pas;
+		}
+		return true;
+	}
+
+	if(!deltas){
+		if((size_t)(fin - p) < n*sizeof(float)) return false;
+		memcpy(positions, p, n*sizeof(float));
+		memcpy(&etat.bits[0], p, n*sizeof(float));
+		return true;
+	}
+	if(!decoderValeurs(p, fin, &etat.valeurs[0], n)) return false;
+	for(size_t i=0; i<n; i++) etat.bits[i] ^= etat.valeurs[i];
+	memcpy(positions, &etat.bits[0], n*sizeof(float));
+	return true;
+}
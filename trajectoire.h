@@ -0,0 +1,164 @@
+#ifndef TRAJECTOIRE_H
+#define TRAJECTOIRE_H
+
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "tissu.h"
+
+/* Enregistrement des positions des particules, image par image, dans un fichier .trj :
+ une entete, les images les unes a la suite des autres, puis l'index (debut et taille de
+ chaque image). Les images sont groupees en blocs de images_par_bloc : la premiere image
+ d'un bloc se decode seule, les suivantes (avec TRAJECTOIRE_DELTAS) ne codent que
+ l'ecart a ce que l'on predit des images precedentes du bloc.
+
+ TRAJECTOIRE_QUANTIFIEE : chaque coordonnee est un entier sur la grille de la boite
+ englobante de la premiere image du bloc, coupee en 65536 pas dans sa plus grande
+ dimension (16 bits pour la premiere image, erreur d'au plus un demi-pas).
+ Sans : les floats sont gardes tels quels (avec les deltas, le ou exclusif avec l'image
+ precedente), sans perte.
+ Les ecarts sont des entiers a longueur variable (7 bits par octet), une suite de zeros
+ (particules immobiles, tissu au repos) prend un seul code. */
+enum { TRAJECTOIRE_QUANTIFIEE = 1, TRAJECTOIRE_DELTAS = 2 };
+
+#define TRAJECTOIRE_VERSION 1
+
+struct EnteteTrajectoire {
+	char magique[8]; // "TISSUTRJ"
+	uint32_t version;
+	uint32_t options; // TRAJECTOIRE_QUANTIFIEE | TRAJECTOIRE_DELTAS
+	uint32_t nb_particules;
+	uint32_t large, hauteur; // particules dans la largeur et la hauteur
+	uint32_t images_par_bloc;
+	uint64_t nb_images;
+	uint64_t debut_index; // 0 : le fichier n'a pas ete ferme, il n'y a pas d'index
+	uint8_t reserve[16];
+};
+
+struct EntreeIndex {
+	uint64_t debut, taille; // en octets depuis le debut du fichier
+};
+
+/* positions de reference et prediction d'un bloc : ce que le codeur et le decodeur
+ gardent d'une image a l'autre */
+struct EtatTrajectoire {
+	float origine[3], pas; // grille du bloc (TRAJECTOIRE_QUANTIFIEE)
+	std::vector<int32_t> q1, q2; // coordonnees entieres des deux images precedentes
+	std::vector<uint32_t> bits; // floats de l'image precedente (sans quantification)
+	std::vector<uint32_t> valeurs; // ecarts de l'image en cours
+};
+
+// ========== ENREGISTREUR ==========
+/* Le thread de simulation ne fait que copier les positions dans un tampon libre
+ (ajouterImage) ; un thread d'ecriture les code et les ecrit dans le fichier par une
+ fenetre projetee en memoire (mmap) qui avance avec le fichier. S'il n'y a plus de
+ tampon libre (disque lent), l'image est perdue plutot que de bloquer la simulation :
+ ajouterImage retourne false, getNbPerdues les compte et fermer en donne le nombre. La
+ relecture saute alors les images perdues. Avec attendre, ajouterImage attend au
+ contraire qu'un tampon se libere : aucune image n'est perdue, mais la simulation va au
+ pas du disque. */
+class Enregistreur {
+private:
+	int fichier; // descripteur, -1 si ferme
+	EnteteTrajectoire entete;
+	std::vector<EntreeIndex> index;
+	std::atomic<bool> erreur; // mise par le thread d'ecriture : l'enregistrement s'arrete
+
+	// fenetre projetee : [debut_fenetre, debut_fenetre + TAILLE_FENETRE) du fichier
+	uint8_t *fenetre;
+	uint64_t debut_fenetre;
+	uint64_t taille; // octets ecrits
+
+	// images en attente du thread d'ecriture
+	std::vector<std::vector<float> > tampons;
+	std::deque<int> libres, pleins;
+	std::mutex verrou;
+	std::condition_variable changement;
+	bool arret;
+	std::thread thread;
+	bool attendre; // ajouterImage attend un tampon libre au lieu de perdre l'image
+	std::atomic<long> nb_images; // images donnees par ajouterImage, perdues comprises (lu par d'autres threads)
+	std::atomic<long> nb_perdues;
+
+	EtatTrajectoire etat;
+	std::vector<uint8_t> code; // image codee avant la copie dans le fichier
+
+	void boucle();
+	void coder(const float *positions, long numero);
+	void ecrire(const void *donnees, size_t nb_octets);
+	bool deplacerFenetre(uint64_t position);
+
+	Enregistreur(const Enregistreur&);
+	Enregistreur &operator=(const Enregistreur&);
+
+public:
+	Enregistreur();
+	~Enregistreur(); // ferme le fichier s'il est ouvert
+
+	/* cree (ou remplace) le fichier pour un tissu de la taille de celui-ci, avec nb_tampons
+	 images en attente au plus (chacune 12 octets par particule) ; false en cas d'erreur */
+	bool ouvrir(const char *chemin, const Tissu &tissu, int options = TRAJECTOIRE_QUANTIFIEE | TRAJECTOIRE_DELTAS, int images_par_bloc = 32,
+		int nb_tampons = 3, bool attendre = false);
+
+	/* copie les positions du tissu (meme nombre de particules qu'a l'ouverture) ; false si
+	 l'image n'est pas enregistree (perdue faute de tampon libre, fichier ferme ou en erreur) */
+	bool ajouterImage(const Tissu &tissu);
+
+	/* attend que toutes les images soient ecrites, ecrit l'index et l'entete et signale
+	 les images perdues sur stderr ; false si une ecriture a echoue */
+	bool fermer();
+
+	bool estOuvert() const { return fichier >= 0; }
+	long getNbImages() const { return nb_images.load(std::memory_order_relaxed); }
+	long getNbPerdues() const { return nb_perdues.load(std::memory_order_relaxed); }
+};
+
+// ========== LECTEUR ==========
+/* Relit un fichier ferme par Enregistreur::fermer : tout le fichier est projete en
+ memoire en lecture seule et les images sont decodees a la demande. Lire les images
+ dans l'ordre ne decode que l'image demandee ; sauter ailleurs repart de la premiere
+ image du bloc. */
+class LecteurTrajectoire {
+private:
+	const uint8_t *donnees;
+	size_t taille;
+	const EnteteTrajectoire *entete;
+	const EntreeIndex *index;
+
+	EtatTrajectoire etat;
+	long courante; // derniere image decodee dans etat, -1 si aucune
+
+	bool decoder(long n, float *positions);
+
+	LecteurTrajectoire(const LecteurTrajectoire&);
+	LecteurTrajectoire &operator=(const LecteurTrajectoire&);
+
+public:
+	LecteurTrajectoire();
+	~LecteurTrajectoire();
+
+	/* false si le fichier n'existe pas, n'est pas une trajectoire ou n'a pas d'index */
+	bool ouvrir(const char *chemin);
+	void fermer();
+	bool estOuvert() const { return donnees != 0; }
+
+	int getNbParticules() const { return entete->nb_particules; }
+	int getLarge() const { return entete->large; }
+	int getHauteur() const { return entete->hauteur; }
+	int getOptions() const { return entete->options; }
+	int getImagesParBloc() const { return entete->images_par_bloc; }
+	long getNbImages() const { return (long) entete->nb_images; }
+
+	/* positions de l'image n en trois plans (x, y puis z, comme Tissu::copierPositions) ;
+	 false si n est hors du fichier ou si l'image est corrompue */
+	bool lireImage(long n, float *positions);
+
+	/* demande au systeme de charger a l'avance les octets des images [premiere, derniere] */
+	void precharger(long premiere, long derniere) const;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef VEC3_H
+#define VEC3_H
+
+#include <math.h>
+#include <algorithm>
+
+// ========== DEFINITION DE LA CLASSE VEC3 ==========
+class Vec3 {	
+public:
+	float f[3]; // tableau de taille 3
+
+	Vec3(float x, float y, float z){
+		f[0] =x;
+		f[1] =y;
+		f[2] =z;
+	}
+
+	Vec3() {}
+
+	// calcul de la taille 
+	float length() const {
+		return sqrt(f[0]*f[0]+f[1]*f[1]+f[2]*f[2]);
+	}
+
+	// normalisation
+	Vec3 normalized() const {
+		float l = length();
+		return Vec3(f[0]/l,f[1]/l,f[2]/l);
+	}
+
+	// surcharge des operateurs
+	void operator+= (const Vec3 &v){
+		f[0]+=v.f[0];
+		f[1]+=v.f[1];
+		f[2]+=v.f[2];
+	}
+
+	Vec3 operator/ (const float &a) const {
+		return Vec3(f[0]/a,f[1]/a,f[2]/a);
+	}
+
+	Vec3 operator- (const Vec3 &v) const {
+		return Vec3(f[0]-v.f[0],f[1]-v.f[1],f[2]-v.f[2]);
+	}
+
+	Vec3 operator+ (const Vec3 &v) const {
+		return Vec3(f[0]+v.f[0],f[1]+v.f[1],f[2]+v.f[2]);
+	}
+
+	Vec3 operator* (const float &a) const {
+		return Vec3(f[0]*a,f[1]*a,f[2]*a);
+	}
+
+	Vec3 operator-() const {
+		return Vec3(-f[0],-f[1],-f[2]);
+	}
+
+	Vec3 cross(const Vec3 &v) const {
+		return Vec3(f[1]*v.f[2] - f[2]*v.f[1], f[2]*v.f[0] - f[0]*v.f[2], f[0]*v.f[1] - f[1]*v.f[0]);
+	}
+
+
+	float dot(const Vec3 &v) const {
+		return f[0]*v.f[0] + f[1]*v.f[1] + f[2]*v.f[2];
+	}
+	
+	float distanceCube() const {
+		// d(A,B) = Max(|xb-xa| + |yb-ya| + |zb-za|)
+		float tmpx = fabs(f[0]);
+		float tmpy = fabs(f[1]);
+		float tmpz = fabs(f[2]);
+		float tmp =  std::max(tmpx,tmpy);
+		return std::max(tmp, tmpz);
+	}
+};
+
+#endif